@@ -4,18 +4,215 @@
 #include<vector>
 #include<memory>
 #include<iostream>
+#include<algorithm>
+#include<stdexcept>
+#include<chrono>
+#include<thread>
+#include<atomic>
+#include<future>
+#include<exception>
 #include "layer.h"
 #include "losses.h"
+#include "metrics.h"
+
+struct MemoryPlan {
+    size_t before_bytes = 0;    // every layer holding its own input and output copies
+    size_t saved_bytes = 0;     // state kept alive for backward
+    size_t buffer_bytes = 0;    // the two ping-pong activation buffers
+    size_t checkpoint_bytes = 0;    // segment inputs kept when checkpointing
+    int widest = 0;
+
+    size_t after_bytes() const { return saved_bytes + buffer_bytes + checkpoint_bytes; }
+};
 
 class NN {
     public:
     std::vector<std::unique_ptr<Layer>> layers;
+    bool compiled = false;
+    bool training = true;
+    std::vector<double> ping;
+    std::vector<double> pong;
+    int checkpoint_every = 0;
+    std::vector<size_t> checkpoint_marks;
+    std::vector<std::vector<double>> checkpoints;
+    const std::vector<std::vector<double>>* validation_X = nullptr;
+    const std::vector<std::vector<double>>* validation_Y = nullptr;
+    int validate_every = 0;
+    int validation_metrics = METRIC_ALL;
+    int validation_threads = 1;
+    std::vector<std::pair<int, Evaluation>> validation_history;
 
     void add(Layer* layer){
-        layers.emplace_back(layer);
+        std::unique_ptr<Layer> owned(layer);
+        // SparseLinear returns no input gradient, so nothing may sit before it.
+        if(!layers.empty() && dynamic_cast<SparseLinear*>(layer) != nullptr){
+            throw std::invalid_argument("SparseLinear must be the first layer");
+        }
+        layers.push_back(std::move(owned));
+    }
+
+    MemoryPlan plan(bool training) const {
+        /**
+         * @brief Computes activation memory of the layer sequence without changing it
+         *
+         * Walks the layers propagating the sample width and sums what each
+         * layer would keep for backward; inference keeps nothing. With
+         * checkpointing only the segment inputs plus the largest segment's
+         * backward state are alive at once. Every
+         * layer output shares two buffers sized for the widest one (the
+         * network input stays in the caller's vector).
+         *
+         * @param training Whether backward state has to survive the forward pass
+         * @return MemoryPlan Peak activation bytes per sample before and after planning
+         * @throws std::invalid_argument if no layer fixes the input width
+         */
+        MemoryPlan result;
+        int width = 0;
+        for(const auto& layer : layers){
+            if(layer->input_width() > 0){
+                width = layer->input_width();
+                break;
+            }
+        }
+        if(width == 0) throw std::invalid_argument("Cannot infer the network input width");
+
+        std::vector<size_t> starts = segment_starts();
+        size_t segment = 0;
+        size_t segment_bytes = 0;
+        for(size_t i = 0; i < layers.size(); i++){
+            if(checkpointing() && segment < starts.size() && starts[segment] == i){
+                segment++;
+                segment_bytes = 0;
+                if(training) result.checkpoint_bytes += width * sizeof(double);
+            }
+            int next = layers[i]->output_width(width);
+            result.before_bytes += (width + next) * sizeof(double);
+            if(training){
+                segment_bytes += layers[i]->saved_bytes(width);
+                result.saved_bytes = checkpointing() ? std::max(result.saved_bytes, segment_bytes) : result.saved_bytes + layers[i]->saved_bytes(width);
+            }
+            result.widest = std::max(result.widest, next);
+            width = next;
+        }
+        result.buffer_bytes = 2 * result.widest * sizeof(double);
+        return result;
+    }
+
+    MemoryPlan compile(bool training = false, bool verbose = true){
+        /**
+         * @brief Switches the network to planned activation memory
+         *
+         * Each layer keeps only what its backward needs (Linear its input,
+         * Relu a sign mask, Sigmoid/Tanh their output), or nothing at all for
+         * inference, and forward_propagation alternates between two reused
+         * buffers sized for the widest layer. back_propagation is rejected on
+         * a network compiled for inference. Linear layers built before a
+         * kernel selector was installed pick their kernel here.
+         *
+         * @param training Keep backward state (true) or compile for inference only (false)
+         * @param verbose Print the before/after peak memory to stdout
+         * @return MemoryPlan The plan that was applied
+         */
+        MemoryPlan result = plan(training);
+        for(auto& layer : layers){
+            if(Linear* linear = dynamic_cast<Linear*>(layer.get())) linear->select_kernel();
+            layer->storage = training && !checkpointing() ? ActivationStorage::Backward : ActivationStorage::None;
+            layer->release();
+        }
+        ping.reserve(result.widest);
+        pong.reserve(result.widest);
+        compiled = true;
+        this->training = training;
+
+        if(verbose){
+            std::cout << "Peak activation memory: " << result.before_bytes << " bytes -> "
+                      << result.after_bytes() << " bytes (" << (training ? "training" : "inference") << ")" << std::endl;
+        }
+        return result;
+    }
+
+    bool checkpointing() const {
+        return checkpoint_every > 0 || !checkpoint_marks.empty();
+    }
+
+    std::vector<size_t> segment_starts() const {
+        /**
+         * @brief Layer indices where a recomputation segment begins
+         * @return std::vector<size_t> Sorted, unique; always starts with 0
+         */
+        std::vector<size_t> starts = {0};
+        for(size_t i = 0; checkpoint_every > 0 && i < layers.size(); i += checkpoint_every){
+            starts.push_back(i);
+        }
+        for(size_t mark : checkpoint_marks){
+            if(mark < layers.size()) starts.push_back(mark);
+        }
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+        return starts;
+    }
+
+    MemoryPlan set_checkpointing(int every, bool verbose = true){
+        /**
+         * @brief Enables activation recomputation (gradient checkpointing)
+         *
+         * The forward pass keeps only the input of every segment of `every`
+         * layers (plus segments begun by mark_checkpoint). back_propagation
+         * re-runs each segment's forward from its checkpoint just before
+         * running its backward, trading one extra forward pass for keeping a
+         * single segment's activations alive. Smaller `every` saves less per
+         * segment but stores more checkpoints; about sqrt(layers) balances both.
+         *
+         * @param every Segment length in layers; 0 disables (marks still apply)
+         * @param verbose Print the resulting peak memory, as compile() does
+         * @return MemoryPlan The resulting training memory plan
+         */
+        checkpoint_every = every;
+        checkpoints.clear();
+        return compile(true, verbose);
+    }
+
+    MemoryPlan mark_checkpoint(size_t layer_index, bool verbose = true){
+        /**
+         * @brief Starts a recomputation segment at the given layer
+         * @param layer_index Index into layers whose input is checkpointed
+         * @param verbose Print the resulting peak memory, as compile() does
+         * @return MemoryPlan The resulting training memory plan
+         * @throws std::out_of_range if layer_index is not a layer of the network
+         */
+        if(layer_index >= layers.size()) throw std::out_of_range("Checkpoint mark outside the network");
+        checkpoint_marks.push_back(layer_index);
+        checkpoints.clear();
+        return compile(true, verbose);
+    }
+
+    std::vector<double> forward_checkpointed(const std::vector<double>& input){
+        std::vector<size_t> starts = segment_starts();
+        checkpoints.resize(starts.size());
+        const std::vector<double>* data = &input;
+        size_t segment = 0;
+        for(size_t i = 0; i < layers.size(); i++){
+            if(training && segment < starts.size() && starts[segment] == i){
+                checkpoints[segment++] = *data;
+            }
+            std::vector<double>& buffer = i % 2 == 0 ? ping : pong;
+            layers[i]->forward_into(*data, buffer);
+            data = &buffer;
+        }
+        return *data;
     }
 
     std::vector<double> forward_propagation(std::vector<double> input){
+        if(checkpointing()) return forward_checkpointed(input);
+        if(compiled){
+            const std::vector<double>* data = &input;
+            for(size_t i = 0; i < layers.size(); i++){
+                std::vector<double>& buffer = i % 2 == 0 ? ping : pong;
+                layers[i]->forward_into(*data, buffer);
+                data = &buffer;
+            }
+            return *data;
+        }
         std::vector<double> data = input;
         for(const auto& layer : layers){
             data = layer->forward(data);
@@ -23,18 +220,211 @@ class NN {
         return data;
     }
 
+    std::vector<double> forward_propagation(const SparseVector& input){
+        SparseLinear* first = layers.empty() ? nullptr : dynamic_cast<SparseLinear*>(layers[0].get());
+        if(first == nullptr) throw std::invalid_argument("Sparse input requires a SparseLinear first layer");
+        if(checkpointing()) throw std::logic_error("Checkpointing does not support sparse input");
+        std::vector<double> data = first->forward(input);
+        for(size_t i = 1; i < layers.size(); i++){
+            data = layers[i]->forward(data);
+        }
+        return data;
+    }
+
     std::vector<double> predict (std::vector<double> input){
         return forward_propagation(input);
     }
 
+    std::vector<double> predict (const SparseVector& input){
+        return forward_propagation(input);
+    }
+
     void back_propagation(std::vector<double> error, double learning_rate){
+        if(compiled && !training) throw std::logic_error("Network was compiled for inference only");
+        if(checkpointing()){
+            back_propagation_checkpointed(error, learning_rate);
+            return;
+        }
         std::vector<double> data = error;
         for(auto it = layers.rbegin(); it != layers.rend(); ++it){
             data = (*it)->backward(data, learning_rate);
         }
     }
 
+    void back_propagation_checkpointed(std::vector<double> error, double learning_rate){
+        std::vector<size_t> starts = segment_starts();
+        if(checkpoints.size() != starts.size()) throw std::logic_error("back_propagation called before forward_propagation");
+        std::vector<double> data = error;
+        for(size_t segment = starts.size(); segment-- > 0;){
+            size_t begin = starts[segment];
+            size_t end = segment + 1 < starts.size() ? starts[segment + 1] : layers.size();
+
+            const std::vector<double>* activation = &checkpoints[segment];
+            for(size_t i = begin; i < end; i++){
+                std::vector<double>& buffer = i % 2 == 0 ? ping : pong;
+                layers[i]->storage = ActivationStorage::Backward;
+                layers[i]->forward_into(*activation, buffer);
+                activation = &buffer;
+            }
+            for(size_t i = end; i-- > begin;){
+                data = layers[i]->backward(data, learning_rate);
+                layers[i]->storage = ActivationStorage::None;
+                layers[i]->release();
+            }
+        }
+    }
+
+    void checkpoint_report(const std::vector<std::vector<double>>& X, std::vector<std::vector<double>>& Y, std::vector<int> every){
+        /**
+         * @brief Prints peak activation memory and step time for several segment lengths
+         *
+         * Each configuration runs one pass over X with learning rate 0, so the
+         * weights are left untouched. Marks from mark_checkpoint are ignored
+         * during the report, so 0 in `every` measures plain compiled training.
+         * The network's compile and checkpointing state and every layer's
+         * storage mode are restored afterwards.
+         */
+        bool was_compiled = compiled, was_training = training;
+        int previous_every = checkpoint_every;
+        std::vector<size_t> previous_marks = checkpoint_marks;
+        std::vector<ActivationStorage> previous_storage;
+        for(const auto& layer : layers) previous_storage.push_back(layer->storage);
+
+        checkpoint_marks.clear();
+        std::cout << "k\tpeak_bytes\tstep_us" << std::endl;
+        for(int k : every){
+            checkpoint_every = k;
+            checkpoints.clear();
+            MemoryPlan memory = compile(true, false);
+            auto start = std::chrono::steady_clock::now();
+            for(size_t i = 0; i < X.size(); i++){
+                std::vector<double> out = forward_propagation(X[i]);
+                back_propagation(BCELossDerivative(Y[i], out), 0);
+            }
+            auto end = std::chrono::steady_clock::now();
+            double step_us = std::chrono::duration<double, std::micro>(end - start).count() / X.size();
+            std::cout << k << "\t" << memory.after_bytes() << "\t" << step_us << std::endl;
+        }
+
+        checkpoint_every = previous_every;
+        checkpoint_marks = previous_marks;
+        checkpoints.clear();
+        compiled = was_compiled;
+        training = was_training;
+        for(size_t i = 0; i < layers.size(); i++){
+            layers[i]->release();
+            layers[i]->storage = previous_storage[i];
+        }
+    }
+
+    NN clone() const {
+        /**
+         * @brief Deep copy of the layers, meant for inference on a weight snapshot
+         * @return NN A network compiled for inference, holding copies of every layer
+         */
+        NN copy;
+        for(const auto& layer : layers){
+            copy.add(layer->clone());
+            copy.layers.back()->storage = ActivationStorage::None;
+            copy.layers.back()->release();
+        }
+        copy.compiled = true;
+        copy.training = false;
+        return copy;
+    }
+
+    Evaluation evaluate(const std::vector<std::vector<double>>& X, const std::vector<std::vector<double>>& Y,
+                        int metrics = METRIC_ALL, int threads = 0, size_t batch_size = 256) const {
+        /**
+         * @brief Scores a labelled dataset in one parallel, forward-only pass
+         *
+         * Worker threads claim batches of samples from a shared counter and
+         * run them through Layer::infer, which caches no activations and
+         * touches no layer state, so the network is only read. Each thread
+         * aggregates loss, accuracy, the AUC histograms and the calibration
+         * bins privately; the partials are merged at the end. With more than
+         * one worker, kernels are capped to one thread each so multi-threaded
+         * Linear kernels do not oversubscribe the cores. An exception thrown
+         * by any worker is rethrown here once every worker has finished.
+         *
+         * @param metrics Bitwise OR of Metric flags to report; the rest stay NaN
+         * @param threads Worker count; 0 uses every hardware thread
+         * @param batch_size Samples claimed by a worker at a time
+         * @return Evaluation The requested metrics over all of X
+         */
+        if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t batches = (X.size() + batch_size - 1) / batch_size;
+        threads = std::max<size_t>(1, std::min<size_t>(threads, batches));
+
+        std::atomic<size_t> next_batch(0);
+        std::vector<MetricAccumulator> partial(threads);
+        std::vector<std::exception_ptr> failures(threads);
+        auto worker = [&](int t){
+            int previous_limit = kernelThreadLimit();
+            if(threads > 1) kernelThreadLimit() = 1;
+            std::vector<double> ping, pong;
+            try{
+                for(size_t b = next_batch++; b < batches; b = next_batch++){
+                    size_t end = std::min(X.size(), (b + 1) * batch_size);
+                    for(size_t i = b * batch_size; i < end; i++){
+                        const std::vector<double>* data = &X[i];
+                        for(size_t l = 0; l < layers.size(); l++){
+                            std::vector<double>& buffer = l % 2 == 0 ? ping : pong;
+                            layers[l]->infer(*data, buffer);
+                            data = &buffer;
+                        }
+                        partial[t].add(Y[i], *data);
+                    }
+                }
+            }
+            catch(...){
+                failures[t] = std::current_exception();
+                next_batch = batches;   // the other workers stop at their next batch
+            }
+            kernelThreadLimit() = previous_limit;
+        };
+
+        std::vector<std::thread> pool;
+        for(int t = 1; t < threads; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for(auto& thread : pool) thread.join();
+        for(const std::exception_ptr& failure : failures)
+            if(failure) std::rethrow_exception(failure);
+
+        for(int t = 1; t < threads; t++) partial[0].merge(partial[t]);
+        return partial[0].result(metrics);
+    }
+
+    void set_validation(const std::vector<std::vector<double>>& X, const std::vector<std::vector<double>>& Y, int every, int metrics = METRIC_ALL,
+                        int threads = std::max(1, int(std::thread::hardware_concurrency()) - 1)){
+        /**
+         * @brief Makes fit() evaluate X, Y every `every` epochs on a background thread
+         *
+         * Validation runs on a clone of the network, so training continues
+         * immediately. A result is printed and added to validation_history
+         * once it is ready. If the previous one is still running when the
+         * next is due, fit() waits for it, and it waits for the last one
+         * before returning.
+         * X and Y are referenced, not copied, and must outlive fit().
+         *
+         * @param threads Evaluation workers; the default leaves one core to training
+         */
+        validation_X = &X;
+        validation_Y = &Y;
+        validate_every = every;
+        validation_metrics = metrics;
+        validation_threads = std::max(1, threads);
+    }
+
+    void report_validation(int epoch, const Evaluation& result){
+        validation_history.emplace_back(epoch, result);
+        std::cout << "Epoch: " << epoch << " Validation loss: " << result.loss << " accuracy: " << result.accuracy
+                  << " AUC: " << result.auc << " ECE: " << result.ece << std::endl;
+    }
+
     void fit(const std::vector<std::vector<double>>&X, std::vector<std::vector<double>>&Y, int epochs, double learning_rate){
+        std::future<Evaluation> pending;
+        int pending_epoch = -1;
         for(int epoch = 0; epoch < epochs; epoch++){
             double total_loss = 0;
             for(size_t i = 0; i < X.size(); i++){
@@ -45,6 +435,38 @@ class NN {
                 back_propagation(loss_derivative, learning_rate);
             }
             std::cout << "Epoch: " << epoch << " Loss: " << total_loss << std::endl;
+
+            if(pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready){
+                report_validation(pending_epoch, pending.get());
+            }
+            // A validation still running from an earlier epoch is waited for rather than doubled up or skipped.
+            if(validate_every > 0 && (epoch + 1) % validate_every == 0){
+                if(pending.valid()) report_validation(pending_epoch, pending.get());
+                std::shared_ptr<NN> snapshot = std::make_shared<NN>(clone());
+                const std::vector<std::vector<double>>* vx = validation_X;
+                const std::vector<std::vector<double>>* vy = validation_Y;
+                int metrics = validation_metrics, threads = validation_threads;
+                pending = std::async(std::launch::async, [snapshot, vx, vy, metrics, threads]{
+                    return snapshot->evaluate(*vx, *vy, metrics, threads);
+                });
+                pending_epoch = epoch;
+            }
+        }
+        if(pending.valid()) report_validation(pending_epoch, pending.get());
+    }
+
+    void fit(const CSRMatrix& X, std::vector<std::vector<double>>& Y, int epochs, double learning_rate){
+        X.check();
+        for(int epoch = 0; epoch < epochs; epoch++){
+            double total_loss = 0;
+            for(int i = 0; i < X.rows; i++){
+                std::vector<double> out = forward_propagation(X.row(i));
+                double loss = BCELoss(Y[i], out);
+                total_loss += loss;
+                std::vector<double> loss_derivative = BCELossDerivative(Y[i], out);
+                back_propagation(loss_derivative, learning_rate);
+            }
+            std::cout << "Epoch: " << epoch << " Loss: " << total_loss << std::endl;
         }
     }
 };
@@ -0,0 +1,205 @@
+#ifndef AUTOTUNE_CPP
+#define AUTOTUNE_CPP
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <sys/stat.h>
+#include "layer.h"
+
+
+    std::string cpuModel() {
+    /**
+     * @brief Returns the host CPU model name, used to key the tuning cache
+     * @return std::string The "model name" from /proc/cpuinfo, or "unknown"
+     */
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.rfind("model name", 0) == 0) {
+                size_t colon = line.find(':');
+                if (colon != std::string::npos) {
+                    std::string model = line.substr(colon + 1);
+                    model.erase(0, model.find_first_not_of(" \t"));
+                    std::replace(model.begin(), model.end(), '\t', ' ');
+                    return model;
+                }
+            }
+        }
+        return "unknown";
+    }
+
+
+    std::string defaultTuneCachePath() {
+    /**
+     * @brief Location of the tuning cache: $NN_TUNE_CACHE, else ~/.cache/nn_tune_cache.tsv
+     */
+        const char* path = std::getenv("NN_TUNE_CACHE");
+        if (path != nullptr) return path;
+        const char* home = std::getenv("HOME");
+        if (home != nullptr) return std::string(home) + "/.cache/nn_tune_cache.tsv";
+        return "nn_tune_cache.tsv";
+    }
+
+
+class Autotuner {
+/**
+ * @brief Picks the fastest Linear kernel variant per layer shape and remembers it
+ *
+ * When a Linear layer is built, or its network compiled, after enable() and
+ * its shape is not cached yet, every candidate (loop-order variant x thread count) is timed on a scratch layer
+ * of that shape and the winner is appended to a tab-separated cache file:
+ *
+ *     cpu model, input_neurons, output_neurons, forward, forward threads, backward, backward threads
+ *
+ * Entries for other CPU models are preserved. Layers run one sample at a
+ * time, so the shape key has no batch dimension.
+ */
+    public:
+        std::string cache_path;
+        std::string cpu;
+        std::map<std::pair<int, int>, LinearKernelChoice> cache;
+        int repeats = 20;
+        bool verbose = false;
+
+        static Autotuner& instance(){
+            static Autotuner tuner;
+            return tuner;
+        }
+
+        void enable(const std::string& path = defaultTuneCachePath()){
+            cache_path = path;
+            cpu = cpuModel();
+            load();
+            linearKernelSelector() = [this](int input_neurons, int output_neurons){
+                return select(input_neurons, output_neurons);
+            };
+        }
+
+        void disable(){
+            linearKernelSelector() = nullptr;
+        }
+
+        LinearKernelChoice select(int input_neurons, int output_neurons){
+            // The scratch layer built by tune() asks again from inside the lock.
+            if(tuning) return LinearKernelChoice();
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find({input_neurons, output_neurons});
+            if(it != cache.end()) return it->second;
+            LinearKernelChoice choice = tune(input_neurons, output_neurons);
+            cache[{input_neurons, output_neurons}] = choice;
+            append(input_neurons, output_neurons, choice);
+            return choice;
+        }
+
+        LinearKernelChoice tune(int input_neurons, int output_neurons){
+            /**
+             * @brief Times every candidate kernel for one shape
+             *
+             * Backward candidates run with learning rate 0 so the scratch
+             * weights stay fixed across candidates.
+             *
+             * @return LinearKernelChoice The fastest forward and backward variants
+             */
+            tuning = true;
+            Linear layer(input_neurons, output_neurons);
+            tuning = false;
+            std::vector<double> x = biasInit(input_neurons);
+            std::vector<double> error = biasInit(output_neurons);
+            std::vector<double> out;
+            layer.input = x;
+
+            std::vector<int> thread_counts = {1};
+            int cores = std::thread::hardware_concurrency();
+            for(int t = 2; t <= cores && t <= 8 && t <= output_neurons; t *= 2) thread_counts.push_back(t);
+
+            LinearKernelChoice best;
+            double best_forward = INFINITY, best_backward = INFINITY;
+            for(ForwardKernel kernel : {ForwardKernel::Reference, ForwardKernel::Unrolled4, ForwardKernel::RowBlocked4}){
+                for(int threads : thread_counts){
+                    layer.kernel.forward = kernel;
+                    layer.kernel.forward_threads = threads;
+                    double seconds = time([&]{ layer.infer(x, out); });
+                    if(seconds < best_forward){
+                        best_forward = seconds;
+                        best.forward = kernel;
+                        best.forward_threads = threads;
+                    }
+                }
+            }
+            for(BackwardKernel kernel : {BackwardKernel::Reference, BackwardKernel::Fused}){
+                for(int threads : thread_counts){
+                    if(kernel == BackwardKernel::Reference && threads > 1) continue;
+                    layer.kernel.backward = kernel;
+                    layer.kernel.backward_threads = threads;
+                    double seconds = time([&]{ layer.backward(error, 0); });
+                    if(seconds < best_backward){
+                        best_backward = seconds;
+                        best.backward = kernel;
+                        best.backward_threads = threads;
+                    }
+                }
+            }
+            if(verbose){
+                std::cout << "Tuned Linear " << input_neurons << "x" << output_neurons
+                          << ": forward " << int(best.forward) << "/" << best.forward_threads << " threads"
+                          << ", backward " << int(best.backward) << "/" << best.backward_threads << " threads" << std::endl;
+            }
+            return best;
+        }
+
+        void load(){
+            cache.clear();
+            std::ifstream file(cache_path);
+            std::string line;
+            while(std::getline(file, line)){
+                std::istringstream fields(line);
+                std::string model;
+                int in, out, forward, forward_threads, backward, backward_threads;
+                if(!std::getline(fields, model, '\t')) continue;
+                if(!(fields >> in >> out >> forward >> forward_threads >> backward >> backward_threads)) continue;
+                if(model != cpu) continue;
+                LinearKernelChoice choice;
+                choice.forward = ForwardKernel(forward);
+                choice.forward_threads = forward_threads;
+                choice.backward = BackwardKernel(backward);
+                choice.backward_threads = backward_threads;
+                cache[{in, out}] = choice;
+            }
+        }
+
+    private:
+        std::mutex mutex;
+        static thread_local bool tuning;
+
+        template<typename F>
+        double time(F run){
+            run();
+            auto start = std::chrono::steady_clock::now();
+            for(int r = 0; r < repeats; r++) run();
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // A cache that cannot be written only costs a re-tune next run.
+        void append(int input_neurons, int output_neurons, const LinearKernelChoice& choice){
+            size_t slash = cache_path.rfind('/');
+            if(slash != std::string::npos && slash > 0) mkdir(cache_path.substr(0, slash).c_str(), 0755);
+            std::ofstream file(cache_path, std::ios::app);
+            if(!file) return;
+            file << cpu << '\t' << input_neurons << '\t' << output_neurons << '\t'
+                 << int(choice.forward) << '\t' << choice.forward_threads << '\t'
+                 << int(choice.backward) << '\t' << choice.backward_threads << '\n';
+        }
+};
+
+thread_local bool Autotuner::tuning = false;
+
+
+#endif
\ No newline at end of file
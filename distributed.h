@@ -0,0 +1,623 @@
+#ifndef DISTRIBUTED_CPP
+#define DISTRIBUTED_CPP
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <string>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "NN.h"
+#include "pipeline.h"
+
+
+// Point-to-point link of a ring: every rank sends to rank + 1 and receives
+// from rank - 1 (mod world). That is all a ring all-reduce needs.
+class Transport {
+    public:
+        int rank = 0;
+        int world = 1;
+
+        virtual ~Transport() = default;
+
+        // Sends to the right and receives from the left at the same time, so
+        // no transfer size can deadlock the ring on full buffers.
+        virtual void exchange(const double* send_data, size_t send_count, double* recv_data, size_t recv_count) = 0;
+
+        // Makes every blocked or later exchange fail; safe to call from another thread.
+        virtual void abort() = 0;
+
+        void send(const double* data, size_t count){ exchange(data, count, nullptr, 0); }
+        void recv(double* data, size_t count){ exchange(nullptr, 0, data, count); }
+};
+
+
+class ShmTransport : public Transport {
+/**
+ * @brief Ring transport over one POSIX shared memory segment
+ *
+ * The segment holds a shared abort flag and one lock-free SPSC ring of
+ * doubles per rank (rank r writes channel r, rank r + 1 reads it). Create
+ * it in the launcher before forking; every child inherits the mapping and
+ * only sets its rank. Waiting ranks give up when the flag is raised or, in
+ * a child, when the launcher process has gone away.
+ */
+    public:
+        static const size_t channel_doubles = 1 << 16;
+
+        struct Header {
+            alignas(64) std::atomic<int> aborted;
+        };
+
+        struct Channel {
+            alignas(64) std::atomic<uint64_t> written;
+            alignas(64) std::atomic<uint64_t> read;
+            double buffer[channel_doubles];
+        };
+
+        Header* header = nullptr;
+        Channel* channels = nullptr;
+        size_t bytes = 0;
+        pid_t launcher = 0;
+
+        explicit ShmTransport(int world){
+            this->world = world;
+            launcher = getpid();
+            std::string name = "/nn_ring_" + std::to_string(getpid());
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if(fd < 0) throw std::runtime_error("shm_open failed: " + std::string(strerror(errno)));
+            bytes = sizeof(Header) + sizeof(Channel) * world;
+            if(ftruncate(fd, bytes) != 0){
+                close(fd);
+                shm_unlink(name.c_str());
+                throw std::runtime_error("ftruncate failed: " + std::string(strerror(errno)));
+            }
+            void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            shm_unlink(name.c_str());   // the mapping outlives the name
+            if(memory == MAP_FAILED) throw std::runtime_error("mmap failed: " + std::string(strerror(errno)));
+            header = static_cast<Header*>(memory);
+            new(&header->aborted) std::atomic<int>(0);
+            channels = reinterpret_cast<Channel*>(static_cast<char*>(memory) + sizeof(Header));
+            for(int r = 0; r < world; r++){
+                new(&channels[r].written) std::atomic<uint64_t>(0);
+                new(&channels[r].read) std::atomic<uint64_t>(0);
+            }
+        }
+
+        ~ShmTransport(){
+            if(header != nullptr) munmap(header, bytes);
+        }
+
+        void abort() override {
+            header->aborted.store(1, std::memory_order_release);
+        }
+
+        void exchange(const double* send_data, size_t send_count, double* recv_data, size_t recv_count) override {
+            Channel& out = channels[rank];
+            Channel& in = channels[(rank + world - 1) % world];
+            uint64_t written = out.written.load(std::memory_order_relaxed);
+            uint64_t read = in.read.load(std::memory_order_relaxed);
+            unsigned spins = 0;
+            while(send_count > 0 || recv_count > 0){
+                bool progress = false;
+                uint64_t free_slots = channel_doubles - (written - out.read.load(std::memory_order_acquire));
+                if(send_count > 0 && free_slots > 0){
+                    size_t offset = written % channel_doubles;
+                    size_t n = std::min<size_t>({send_count, free_slots, channel_doubles - offset});
+                    std::memcpy(&out.buffer[offset], send_data, n * sizeof(double));
+                    written += n;
+                    send_data += n;
+                    send_count -= n;
+                    out.written.store(written, std::memory_order_release);
+                    progress = true;
+                }
+                uint64_t available = in.written.load(std::memory_order_acquire) - read;
+                if(recv_count > 0 && available > 0){
+                    size_t offset = read % channel_doubles;
+                    size_t n = std::min<size_t>({recv_count, available, channel_doubles - offset});
+                    std::memcpy(recv_data, &in.buffer[offset], n * sizeof(double));
+                    read += n;
+                    recv_data += n;
+                    recv_count -= n;
+                    in.read.store(read, std::memory_order_release);
+                    progress = true;
+                }
+                if(!progress) wait(spins);
+            }
+        }
+
+    private:
+        void wait(unsigned& spins){
+            if(header->aborted.load(std::memory_order_acquire)) throw std::runtime_error("All-reduce aborted by another rank");
+            if(++spins % 1024 == 0 && getpid() != launcher && getppid() != launcher)
+                throw std::runtime_error("Launcher process exited");
+            std::this_thread::yield();
+        }
+};
+
+
+class TcpTransport : public Transport {
+/**
+ * @brief Ring transport over TCP; rank r listens on base_port + r
+ *
+ * Each rank connects to its right neighbour and accepts its left one, so
+ * the same code works on loopback and, later, across hosts. Setting up the
+ * ring fails after `timeout_seconds` if a neighbour never shows up.
+ */
+    public:
+        int right_fd = -1;
+        int left_fd = -1;
+
+        TcpTransport(int rank, int world, int base_port, const std::string& host = "127.0.0.1", double timeout_seconds = 30){
+            this->rank = rank;
+            this->world = world;
+            if(world == 1) return;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout_seconds);
+
+            int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+            int one = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in address = make_address(host, base_port + rank);
+            if(bind(listen_fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(listen_fd, 1) != 0){
+                close(listen_fd);
+                throw std::runtime_error("TCP listen failed: " + std::string(strerror(errno)));
+            }
+
+            sockaddr_in right = make_address(host, base_port + (rank + 1) % world);
+            while(true){
+                right_fd = socket(AF_INET, SOCK_STREAM, 0);
+                if(connect(right_fd, (sockaddr*)&right, sizeof(right)) == 0) break;
+                int error = errno;
+                close(right_fd);
+                right_fd = -1;
+                if(std::chrono::steady_clock::now() >= deadline){
+                    close(listen_fd);
+                    throw std::runtime_error("TCP connect failed: " + std::string(strerror(error)));
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            pollfd pending = {listen_fd, POLLIN, 0};
+            while(true){
+                int remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                int ready = poll(&pending, 1, std::max(0, remaining));
+                if(ready > 0) break;
+                if(ready < 0 && errno == EINTR) continue;
+                int error = ready == 0 ? ETIMEDOUT : errno;
+                close(listen_fd);
+                throw std::runtime_error("TCP accept failed: " + std::string(strerror(error)));
+            }
+            left_fd = accept(listen_fd, nullptr, nullptr);
+            int error = errno;
+            close(listen_fd);
+            if(left_fd < 0) throw std::runtime_error("TCP accept failed: " + std::string(strerror(error)));
+            setsockopt(right_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            setsockopt(left_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        ~TcpTransport(){
+            if(right_fd >= 0) close(right_fd);
+            if(left_fd >= 0) close(left_fd);
+        }
+
+        void abort() override {
+            if(right_fd >= 0) shutdown(right_fd, SHUT_RDWR);
+            if(left_fd >= 0) shutdown(left_fd, SHUT_RDWR);
+        }
+
+        void exchange(const double* send_data, size_t send_count, double* recv_data, size_t recv_count) override {
+            const char* out = reinterpret_cast<const char*>(send_data);
+            char* in = reinterpret_cast<char*>(recv_data);
+            size_t out_left = send_count * sizeof(double), in_left = recv_count * sizeof(double);
+            while(out_left > 0 || in_left > 0){
+                pollfd fds[2] = {{out_left > 0 ? right_fd : -1, POLLOUT, 0}, {in_left > 0 ? left_fd : -1, POLLIN, 0}};
+                if(poll(fds, 2, -1) < 0){
+                    if(errno == EINTR) continue;
+                    throw std::runtime_error("TCP poll failed: " + std::string(strerror(errno)));
+                }
+                if(fds[0].revents != 0){
+                    ssize_t n = ::send(right_fd, out, out_left, MSG_NOSIGNAL | MSG_DONTWAIT);
+                    if(n < 0 && !retryable(errno)) throw std::runtime_error("TCP send failed: " + std::string(strerror(errno)));
+                    if(n > 0){
+                        out += n;
+                        out_left -= n;
+                    }
+                }
+                if(fds[1].revents != 0){
+                    ssize_t n = ::recv(left_fd, in, in_left, MSG_DONTWAIT);
+                    if(n == 0) throw std::runtime_error("TCP recv failed: connection closed");
+                    if(n < 0 && !retryable(errno)) throw std::runtime_error("TCP recv failed: " + std::string(strerror(errno)));
+                    if(n > 0){
+                        in += n;
+                        in_left -= n;
+                    }
+                }
+            }
+        }
+
+    private:
+        static bool retryable(int error){
+            return error == EINTR || error == EAGAIN || error == EWOULDBLOCK;
+        }
+
+        static sockaddr_in make_address(const std::string& host, int port){
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            inet_pton(AF_INET, host.c_str(), &address.sin_addr);
+            return address;
+        }
+};
+
+
+    void ringAllReduce(Transport& transport, double* data, size_t count, size_t chunk = 4096) {
+    /**
+     * @brief Sums `data` element-wise across all ranks, in place
+     *
+     * The buffer is cut into `world` segments. A reduce-scatter pass leaves
+     * every rank with one fully summed segment, and an all-gather pass
+     * circulates those segments. Every transfer is further split into
+     * `chunk`-sized pieces, so reducing one piece overlaps with the next one
+     * in flight. Each piece is sent and received concurrently, so any chunk
+     * size is safe regardless of the transport's buffering.
+     *
+     * @param transport The ring link of this rank
+     * @param data The local buffer, replaced by the sum over ranks
+     * @param count Number of doubles in data; must match on every rank
+     * @param chunk Pipelining granularity in doubles
+     * @throws std::invalid_argument if chunk is 0
+     */
+        int world = transport.world, rank = transport.rank;
+        if (world == 1) return;
+        if (chunk == 0) throw std::invalid_argument("All-reduce chunk must be positive");
+
+        auto segment_begin = [&](int segment) { return count * segment / world; };
+        std::vector<double> incoming(chunk);
+
+        for (int step = 0; step < world - 1; step++) {
+            int send_segment = (rank - step + world) % world;
+            int recv_segment = (rank - step - 1 + world) % world;
+            size_t send_begin = segment_begin(send_segment), send_end = segment_begin(send_segment + 1);
+            size_t recv_begin = segment_begin(recv_segment), recv_end = segment_begin(recv_segment + 1);
+            size_t pieces = std::max((send_end - send_begin + chunk - 1) / chunk, (recv_end - recv_begin + chunk - 1) / chunk);
+            for (size_t piece = 0; piece < pieces; piece++) {
+                size_t s = std::min(send_begin + piece * chunk, send_end);
+                size_t r = std::min(recv_begin + piece * chunk, recv_end);
+                size_t send_count = std::min(chunk, send_end - s);
+                size_t recv_count = std::min(chunk, recv_end - r);
+                transport.exchange(data + s, send_count, incoming.data(), recv_count);
+                for (size_t i = 0; i < recv_count; i++) data[r + i] += incoming[i];
+            }
+        }
+
+        for (int step = 0; step < world - 1; step++) {
+            int send_segment = (rank + 1 - step + world) % world;
+            int recv_segment = (rank - step + world) % world;
+            size_t send_begin = segment_begin(send_segment), send_end = segment_begin(send_segment + 1);
+            size_t recv_begin = segment_begin(recv_segment), recv_end = segment_begin(recv_segment + 1);
+            size_t pieces = std::max((send_end - send_begin + chunk - 1) / chunk, (recv_end - recv_begin + chunk - 1) / chunk);
+            for (size_t piece = 0; piece < pieces; piece++) {
+                size_t s = std::min(send_begin + piece * chunk, send_end);
+                size_t r = std::min(recv_begin + piece * chunk, recv_end);
+                transport.exchange(data + s, std::min(chunk, send_end - s), data + r, std::min(chunk, recv_end - r));
+            }
+        }
+    }
+
+
+enum class TransportKind { SharedMemory, Tcp };
+
+struct DataParallelOptions {
+    int processes = 2;
+    TransportKind transport = TransportKind::SharedMemory;
+    int tcp_port = 29500;
+    double connect_timeout_seconds = 30;    // TCP ring setup deadline
+    size_t bucket_doubles = 1 << 16;    // gradient bucket size handed to the all-reduce thread
+    size_t chunk_doubles = 4096;        // all-reduce pipelining granularity
+    int local_batch = 1;                // samples per worker between synchronizations
+    bool verbose = true;
+};
+
+class DataParallelWorker {
+    public:
+        NN& nn;
+        Transport* transport;
+        DataParallelOptions options;
+
+        DataParallelWorker(NN& nn, Transport* transport, const DataParallelOptions& options) : nn(nn), transport(transport), options(options) {}
+
+        void all_reduce(std::vector<double>& data){
+            if(transport != nullptr) ringAllReduce(*transport, data.data(), data.size(), options.chunk_doubles);
+        }
+
+        void broadcast_parameters(){
+            /**
+             * @brief Makes every rank start from rank 0's weights
+             *
+             * Done as an all-reduce where every other rank contributes zeros.
+             */
+            std::vector<double> flat;
+            for(auto& layer : nn.layers)
+                for(std::vector<double>* param : layer->parameters())
+                    for(double w : *param) flat.push_back(transport->rank == 0 ? w : 0);
+            all_reduce(flat);
+            size_t k = 0;
+            for(auto& layer : nn.layers)
+                for(std::vector<double>* param : layer->parameters())
+                    for(double& w : *param) w = flat[k++];
+        }
+
+        void fit(const std::vector<std::vector<double>>& X, std::vector<std::vector<double>>& Y, int epochs, double learning_rate){
+            /**
+             * @brief Trains this rank's shard, averaging updates with the other ranks every step
+             *
+             * Each step runs local_batch samples of ordinary SGD, then replaces
+             * the local update by the average update of all ranks. As soon as a
+             * layer's backward returns, its update is appended to a bucket; full
+             * buckets go to a communication thread that all-reduces them while
+             * backward continues through the earlier layers. A failed all-reduce
+             * is rethrown here once the communication thread has stopped. With
+             * several ranks every kernel runs single-threaded, since the ranks
+             * already occupy the cores.
+             */
+            if(nn.checkpointing()) throw std::invalid_argument("Data-parallel training does not support checkpointing");
+            if(nn.compiled && !nn.training) throw std::logic_error("Network was compiled for inference only");
+            int world = transport == nullptr ? 1 : transport->world;
+            int rank = transport == nullptr ? 0 : transport->rank;
+            if(world > 1) broadcast_parameters();
+
+            struct Bucket {
+                std::vector<double> data;
+                size_t first_layer = 0;     // bucket covers layers [first_layer, last_layer), filled last to first
+                size_t last_layer = 0;
+                bool stop = false;
+                std::exception_ptr error;
+            };
+            SPSCQueue<Bucket> to_comm(nn.layers.size() + 1), from_comm(nn.layers.size() + 1);
+            std::thread comm([&]{
+                std::exception_ptr failure;
+                while(true){
+                    Bucket bucket = to_comm.pop();
+                    if(bucket.stop) break;
+                    if(!failure){
+                        try{
+                            all_reduce(bucket.data);
+                        }
+                        catch(...){
+                            failure = std::current_exception();
+                        }
+                    }
+                    bucket.error = failure;
+                    from_comm.push(std::move(bucket));
+                }
+            });
+            auto stop_comm = [&]{
+                Bucket stop;
+                stop.stop = true;
+                to_comm.push(std::move(stop));
+                comm.join();
+            };
+
+            std::vector<std::vector<std::vector<double>>> snapshot(nn.layers.size());
+            size_t steps = X.size() / (size_t(world) * options.local_batch);
+            int previous_limit = kernelThreadLimit();
+            if(world > 1) kernelThreadLimit() = 1;
+            try{
+                for(int epoch = 0; epoch < epochs; epoch++){
+                    std::vector<double> total_loss = {0};
+                    for(size_t step = 0; step < steps; step++){
+                        for(size_t i = 0; i < nn.layers.size(); i++){
+                            snapshot[i].clear();
+                            for(std::vector<double>* param : nn.layers[i]->parameters()) snapshot[i].push_back(*param);
+                        }
+
+                        size_t first_sample = (step * world + rank) * options.local_batch;
+                        std::vector<double> error;
+                        for(int b = 0; b < options.local_batch; b++){
+                            size_t index = first_sample + b;
+                            std::vector<double> out = nn.forward_propagation(X[index]);
+                            total_loss[0] += BCELoss(Y[index], out);
+                            error = BCELossDerivative(Y[index], out);
+                            if(b + 1 < options.local_batch) nn.back_propagation(error, learning_rate);
+                        }
+
+                        // Last sample: backward layer by layer, shipping finished buckets.
+                        size_t buckets = 0;
+                        Bucket bucket;
+                        bucket.last_layer = nn.layers.size();
+                        for(size_t i = nn.layers.size(); i-- > 0;){
+                            error = nn.layers[i]->backward(error, learning_rate);
+                            std::vector<std::vector<double>*> params = nn.layers[i]->parameters();
+                            for(size_t p = 0; p < params.size(); p++)
+                                for(size_t k = 0; k < params[p]->size(); k++)
+                                    bucket.data.push_back((*params[p])[k] - snapshot[i][p][k]);
+                            bucket.first_layer = i;
+                            if(bucket.data.size() >= options.bucket_doubles || i == 0){
+                                to_comm.push(std::move(bucket));
+                                buckets++;
+                                bucket = Bucket();
+                                bucket.last_layer = i;
+                            }
+                        }
+
+                        std::exception_ptr failure;
+                        for(size_t done = 0; done < buckets; done++){
+                            Bucket reduced = from_comm.pop();
+                            if(reduced.error){
+                                failure = reduced.error;
+                                continue;
+                            }
+                            size_t k = 0;
+                            for(size_t i = reduced.last_layer; i-- > reduced.first_layer;){
+                                std::vector<std::vector<double>*> params = nn.layers[i]->parameters();
+                                for(size_t p = 0; p < params.size(); p++)
+                                    for(size_t j = 0; j < params[p]->size(); j++)
+                                        (*params[p])[j] = snapshot[i][p][j] + reduced.data[k++] / world;
+                            }
+                        }
+                        if(failure) std::rethrow_exception(failure);
+                    }
+                    all_reduce(total_loss);
+                    if(rank == 0 && options.verbose) std::cout << "Epoch: " << epoch << " Loss: " << total_loss[0] << std::endl;
+                }
+            }
+            catch(...){
+                kernelThreadLimit() = previous_limit;
+                stop_comm();
+                throw;
+            }
+            kernelThreadLimit() = previous_limit;
+            stop_comm();
+        }
+};
+
+
+    double fitDataParallel(NN& nn, const std::vector<std::vector<double>>& X, std::vector<std::vector<double>>& Y,
+                           int epochs, double learning_rate, const DataParallelOptions& options = DataParallelOptions()) {
+    /**
+     * @brief Trains `nn` with options.processes local worker processes
+     *
+     * The calling process is rank 0 and keeps the trained weights; ranks
+     * 1..N-1 are forked copies that train on their shard and exit. Shards
+     * interleave samples across ranks; samples beyond the last full step of
+     * every rank are skipped.
+     *
+     * @return double Wall-clock training time in seconds
+     * If any rank fails, the others are aborted and rank 0 kills and reaps
+     * every worker before throwing.
+     *
+     * @throws std::runtime_error if the transport cannot be set up or a worker fails
+     */
+        int world = options.processes;
+        if (world < 1) throw std::invalid_argument("Need at least one process");
+        if (X.size() < size_t(world) * options.local_batch) throw std::invalid_argument("Not enough samples for every rank");
+
+        std::unique_ptr<ShmTransport> shm;
+        if (world > 1 && options.transport == TransportKind::SharedMemory) shm.reset(new ShmTransport(world));
+
+        std::cout.flush();
+        std::vector<pid_t> children;
+        auto kill_children = [&]() {
+            for (pid_t pid : children) kill(pid, SIGKILL);
+            for (pid_t pid : children) waitpid(pid, nullptr, 0);
+        };
+        int rank = 0;
+        for (int r = 1; r < world; r++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                int error = errno;
+                kill_children();
+                throw std::runtime_error("fork failed: " + std::string(strerror(error)));
+            }
+            if (pid == 0) {
+                rank = r;
+                children.clear();
+                break;
+            }
+            children.push_back(pid);
+        }
+
+        // Rank 0 watches the workers without reaping them; a worker that dies
+        // aborts the transport so this process does not wait on it forever.
+        std::unique_ptr<TcpTransport> tcp;
+        std::atomic<Transport*> active{nullptr};
+        std::atomic<bool> finished{false};
+        if (world > 1 && shm) {
+            shm->rank = rank;
+            active = shm.get();
+        }
+        std::thread watcher;
+        if (!children.empty()) {
+            watcher = std::thread([&]() {
+                std::vector<bool> exited(children.size(), false);
+                while (!finished.load()) {
+                    for (size_t c = 0; c < children.size(); c++) {
+                        siginfo_t info = {};
+                        if (exited[c] || waitid(P_PID, children[c], &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid == 0) continue;
+                        exited[c] = true;
+                        if (info.si_code == CLD_EXITED && info.si_status == 0) continue;
+                        Transport* transport = active.load();
+                        if (transport != nullptr) transport->abort();
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = true;
+        try {
+            if (world > 1 && !shm) {
+                tcp.reset(new TcpTransport(rank, world, options.tcp_port, "127.0.0.1", options.connect_timeout_seconds));
+                active = tcp.get();
+            }
+            DataParallelWorker(nn, active.load(), options).fit(X, Y, epochs, learning_rate);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Rank " << rank << ": " << e.what() << std::endl;
+            ok = false;
+            if (active.load() != nullptr) active.load()->abort();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (rank != 0) {
+            std::cout.flush();
+            _exit(ok ? 0 : 1);
+        }
+        finished = true;
+        if (watcher.joinable()) watcher.join();
+        if (!ok) {
+            kill_children();
+            throw std::runtime_error("Data-parallel training failed");
+        }
+        for (pid_t pid : children) {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+        }
+        if (!ok) throw std::runtime_error("Data-parallel training failed");
+        return seconds;
+    }
+
+
+    void dataParallelReport(NN& nn, const std::vector<std::vector<double>>& X, std::vector<std::vector<double>>& Y,
+                            int max_processes = 8, TransportKind transport = TransportKind::SharedMemory, int epochs = 1) {
+    /**
+     * @brief Prints throughput and scaling efficiency for 1..max_processes workers
+     *
+     * Runs with learning rate 0, so the weights are left untouched while the
+     * full forward, backward and all-reduce work is still done. Efficiency is
+     * throughput(N) / (N * throughput(1)).
+     */
+        DataParallelOptions options;
+        options.transport = transport;
+        options.verbose = false;
+        double base_rate = 0;
+        std::cout << "processes\tsamples_per_s\tefficiency" << std::endl;
+        for (int p = 1; p <= max_processes; p++) {
+            options.processes = p;
+            double seconds = fitDataParallel(nn, X, Y, epochs, 0, options);
+            double samples = double(X.size() / (p * options.local_batch)) * p * options.local_batch * epochs;
+            double rate = samples / seconds;
+            if (p == 1) base_rate = rate;
+            std::cout << p << "\t" << rate << "\t" << rate / (p * base_rate) << std::endl;
+        }
+    }
+
+
+#endif
\ No newline at end of file
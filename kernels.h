@@ -0,0 +1,160 @@
+#ifndef KERNELS_CPP
+#define KERNELS_CPP
+
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+
+    // Forward variants of y = W x + b. Reference is the plain per-row dotProduct.
+    enum class ForwardKernel { Reference, Unrolled4, RowBlocked4 };
+
+    // Backward variants. Reference transposes W and materializes dE/dW;
+    // Fused does the input error and the weight update in one pass over W.
+    enum class BackwardKernel { Reference, Fused };
+
+    struct LinearKernelChoice {
+        ForwardKernel forward = ForwardKernel::Reference;
+        int forward_threads = 1;
+        BackwardKernel backward = BackwardKernel::Reference;
+        int backward_threads = 1;
+    };
+
+    // Installed by Autotuner::enable(); consulted when a Linear layer is built or its network compiled.
+    typedef std::function<LinearKernelChoice(int input_neurons, int output_neurons)> KernelSelector;
+
+    KernelSelector& linearKernelSelector() {
+        static KernelSelector selector;
+        return selector;
+    }
+
+    // Per-thread cap on the threads a kernel may use, 0 for none. Code that
+    // already runs one worker per core (NN::evaluate) sets it to 1.
+    int& kernelThreadLimit() {
+        thread_local int limit = 0;
+        return limit;
+    }
+
+
+    void parallelRows(int rows, int threads, const std::function<void(int, int, int)>& body) {
+    /**
+     * @brief Runs body(slice, begin, end) over `threads` contiguous slices of [0, rows)
+     *
+     * The calling thread takes the first slice; with one thread no thread is
+     * spawned. The thread count is capped by kernelThreadLimit().
+     */
+        if (kernelThreadLimit() > 0) threads = std::min(threads, kernelThreadLimit());
+        threads = std::max(1, std::min(threads, rows));
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++) {
+            workers.emplace_back(body, t, rows * t / threads, rows * (t + 1) / threads);
+        }
+        body(0, 0, rows / threads);
+        for (auto& worker : workers) worker.join();
+    }
+
+
+    void linearForwardRows(ForwardKernel kernel, const std::vector<std::vector<double>>& weights, const std::vector<double>& bias,
+                           const std::vector<double>& x, std::vector<double>& out, int begin, int end) {
+    /**
+     * @brief Computes out[i] = W[i] . x + b[i] for rows [begin, end) with the given variant
+     */
+        int n = x.size();
+        if (kernel == ForwardKernel::Unrolled4) {
+            for (int i = begin; i < end; i++) {
+                const double* w = weights[i].data();
+                double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+                int j = 0;
+                for (; j + 3 < n; j += 4) {
+                    a0 += w[j] * x[j];
+                    a1 += w[j + 1] * x[j + 1];
+                    a2 += w[j + 2] * x[j + 2];
+                    a3 += w[j + 3] * x[j + 3];
+                }
+                for (; j < n; j++) a0 += w[j] * x[j];
+                out[i] = (a0 + a1) + (a2 + a3) + bias[i];
+            }
+        }
+        else if (kernel == ForwardKernel::RowBlocked4) {
+            int i = begin;
+            for (; i + 3 < end; i += 4) {
+                const double* w0 = weights[i].data();
+                const double* w1 = weights[i + 1].data();
+                const double* w2 = weights[i + 2].data();
+                const double* w3 = weights[i + 3].data();
+                double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+                for (int j = 0; j < n; j++) {
+                    double xj = x[j];
+                    a0 += w0[j] * xj;
+                    a1 += w1[j] * xj;
+                    a2 += w2[j] * xj;
+                    a3 += w3[j] * xj;
+                }
+                out[i] = a0 + bias[i];
+                out[i + 1] = a1 + bias[i + 1];
+                out[i + 2] = a2 + bias[i + 2];
+                out[i + 3] = a3 + bias[i + 3];
+            }
+            for (; i < end; i++) {
+                double acc = 0;
+                for (int j = 0; j < n; j++) acc += weights[i][j] * x[j];
+                out[i] = acc + bias[i];
+            }
+        }
+        else {
+            for (int i = begin; i < end; i++) {
+                double acc = 0;
+                for (int j = 0; j < n; j++) acc += weights[i][j] * x[j];
+                out[i] = acc + bias[i];
+            }
+        }
+    }
+
+
+    void linearForward(const LinearKernelChoice& choice, const std::vector<std::vector<double>>& weights, const std::vector<double>& bias,
+                       const std::vector<double>& x, std::vector<double>& out) {
+    /**
+     * @brief Dispatches a Linear forward pass to the chosen variant and thread count
+     */
+        out.resize(weights.size());
+        parallelRows(weights.size(), choice.forward_threads, [&](int slice, int begin, int end) {
+            linearForwardRows(choice.forward, weights, bias, x, out, begin, end);
+        });
+    }
+
+
+    std::vector<double> linearBackwardFused(std::vector<std::vector<double>>& weights, std::vector<double>& bias,
+                                            const std::vector<double>& x, const std::vector<double>& error,
+                                            double learning_rate, int threads) {
+    /**
+     * @brief Single pass over W computing dE/dX and applying the SGD update
+     *
+     * Each row is read for the input error before it is updated, so the result
+     * matches the reference kernel. With several threads every slice of rows
+     * accumulates a private input error that is summed at the end.
+     *
+     * @return std::vector<double> dE/dX
+     */
+        int rows = weights.size(), n = x.size();
+        threads = std::max(1, std::min(threads, rows));
+        std::vector<std::vector<double>> partial(threads, std::vector<double>(n, 0));
+        parallelRows(rows, threads, [&](int slice, int begin, int end) {
+            std::vector<double>& input_error = partial[slice];
+            for (int i = begin; i < end; i++) {
+                double* w = weights[i].data();
+                double e = error[i];
+                for (int j = 0; j < n; j++) {
+                    input_error[j] += w[j] * e;
+                    w[j] -= (e * x[j]) * learning_rate;
+                }
+                bias[i] -= e * learning_rate;
+            }
+        });
+        for (int t = 1; t < threads; t++)
+            for (int j = 0; j < n; j++) partial[0][j] += partial[t][j];
+        return partial[0];
+    }
+
+
+#endif
\ No newline at end of file
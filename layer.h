@@ -4,87 +4,193 @@
 #include<vector>
 #include "utils.h"
 #include "activation.h"
+#include "sparse.h"
+#include "kernels.h"
+
+// What a layer keeps from forward() for backward(). Full is the historical
+// behaviour (input and output copies); NN::compile() switches layers to
+// Backward (only what backward needs) or None (inference).
+enum class ActivationStorage { Full, Backward, None };
 
 class Layer{
     public:
         std::vector<double> input;
         std::vector<double> output;
-        virtual std::vector<double> forward(const std::vector<double> input_data) = 0;
+        ActivationStorage storage = ActivationStorage::Full;
+
+        virtual ~Layer() = default;
+
+        // Deep copy, used to snapshot a network (e.g. for background validation).
+        virtual Layer* clone() const = 0;
+
+        // Pure forward math: writes the result into out and touches no layer state.
+        virtual void infer(const std::vector<double>& input_data, std::vector<double>& out) const = 0;
+
+        // Stores the minimal state backward() needs; only called when storage != None.
+        virtual void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) = 0;
+
         virtual std::vector<double> backward(std::vector<double> error, double learning_rate) = 0;
+
+        virtual void forward_into(const std::vector<double>& input_data, std::vector<double>& out){
+            infer(input_data, out);
+            if(storage == ActivationStorage::Full){
+                input = input_data;
+                output = out;
+            }
+            if(storage != ActivationStorage::None) save_for_backward(input_data, out);
+        }
+
+        virtual std::vector<double> forward(const std::vector<double> input_data){
+            std::vector<double> out;
+            forward_into(input_data, out);
+            return out;
+        }
+
+        // Input width the layer requires, or 0 for width-preserving layers.
+        virtual int input_width() const { return 0; }
+        virtual int output_width(int input_width) const { return input_width; }
+
+        // Bytes kept alive between forward and backward in ActivationStorage::Backward.
+        virtual size_t saved_bytes(int input_width) const = 0;
+
+        // Trainable tensors, for code that synchronizes or inspects weights generically.
+        virtual std::vector<std::vector<double>*> parameters(){ return {}; }
+
+        virtual void release(){
+            input.clear();
+            input.shrink_to_fit();
+            output.clear();
+            output.shrink_to_fit();
+        }
 };
 
 class Sigmoid : public Layer {
     public:
-        std::vector<double> forward(const std::vector<double> input_data) override {
-            input = input_data;
-            output = vectSigmoid(input_data);
-            return output;
+        Layer* clone() const override { return new Sigmoid(*this); }
+
+        void infer(const std::vector<double>& input_data, std::vector<double>& out) const override {
+            out.resize(input_data.size());
+            for(int i = 0; i < input_data.size(); i++){
+                out[i] = sigmoid(input_data[i]);
+            }
         }
 
+        void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) override {
+            if(storage == ActivationStorage::Backward) output = out;
+        }
+
+        // sigmoid'(x) = s(x) * (1 - s(x)), so the cached output is all backward needs.
         std::vector<double> backward(std::vector<double> error, double learning_rate) override {
-            std::vector<double> derivative = vectSigmoidDerivative(input);
-            std::vector<double> grad_input;
-            for(int i = 0; i < derivative.size(); i++){
-                grad_input.push_back(error[i] * derivative[i]);
+            std::vector<double> grad_input(output.size());
+            for(int i = 0; i < output.size(); i++){
+                grad_input[i] = error[i] * output[i] * (1 - output[i]);
             }
             return grad_input;
         }
+
+        size_t saved_bytes(int input_width) const override { return input_width * sizeof(double); }
 };
 
 class Relu : public Layer {
     public:
-        std::vector<double> forward(const std::vector<double> input_data) override {
-            input = input_data;
-            output = vectRelu(input_data);
-            return output;
+        std::vector<char> mask;     // 1 where input >= 0
+
+        Layer* clone() const override { return new Relu(*this); }
+
+        void infer(const std::vector<double>& input_data, std::vector<double>& out) const override {
+            out.resize(input_data.size());
+            for(int i = 0; i < input_data.size(); i++){
+                out[i] = relu(input_data[i]);
+            }
+        }
+
+        void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) override {
+            mask.resize(input_data.size());
+            for(int i = 0; i < input_data.size(); i++){
+                mask[i] = input_data[i] >= 0;
+            }
         }
 
         std::vector<double> backward(std::vector<double> error, double learning_rate) override {
-            std::vector<double> derivative = vectReluDerivative(input);
-            std::vector<double> grad_input;
-            for(int i = 0; i < derivative.size(); i++){
-                grad_input.push_back(error[i] * derivative[i]);
+            std::vector<double> grad_input(mask.size());
+            for(int i = 0; i < mask.size(); i++){
+                grad_input[i] = mask[i] ? error[i] : 0;
             }
             return grad_input;
         }
+
+        size_t saved_bytes(int input_width) const override { return input_width * sizeof(char); }
+
+        void release() override {
+            Layer::release();
+            mask.clear();
+            mask.shrink_to_fit();
+        }
 };
 
 class LeakyRelu : public Layer {
     public:
         double alpha = 0.01;
+        std::vector<char> mask;     // 1 where input >= 0
+
+        Layer* clone() const override { return new LeakyRelu(*this); }
 
-        std::vector<double> forward(const std::vector<double> input_data) override {
-            input = input_data;
-            output = vectLeakyRelu(input_data, alpha);
-            return output;
+        void infer(const std::vector<double>& input_data, std::vector<double>& out) const override {
+            out.resize(input_data.size());
+            for(int i = 0; i < input_data.size(); i++){
+                out[i] = leakyRelu(input_data[i], alpha);
+            }
+        }
+
+        void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) override {
+            mask.resize(input_data.size());
+            for(int i = 0; i < input_data.size(); i++){
+                mask[i] = input_data[i] >= 0;
+            }
         }
 
         std::vector<double> backward(std::vector<double> error, double learning_rate) override {
-            std::vector<double> derivative = vectLeakyReluDerivative(input, alpha);
-            std::vector<double> grad_input;
-            for(int i = 0; i < derivative.size(); i++){
-                grad_input.push_back(error[i] * derivative[i]);
+            std::vector<double> grad_input(mask.size());
+            for(int i = 0; i < mask.size(); i++){
+                grad_input[i] = mask[i] ? error[i] : alpha * error[i];
             }
             return grad_input;
         }
+
+        size_t saved_bytes(int input_width) const override { return input_width * sizeof(char); }
+
+        void release() override {
+            Layer::release();
+            mask.clear();
+            mask.shrink_to_fit();
+        }
 };
 
 class Tanh : public Layer {
     public:
-        std::vector<double> forward(const std::vector<double> input_data) override {
-            input = input_data;
-            output = vectTanh(input_data);
-            return output;
+        Layer* clone() const override { return new Tanh(*this); }
+
+        void infer(const std::vector<double>& input_data, std::vector<double>& out) const override {
+            out.resize(input_data.size());
+            for(int i = 0; i < input_data.size(); i++){
+                out[i] = tanh(input_data[i]);
+            }
         }
 
+        void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) override {
+            if(storage == ActivationStorage::Backward) output = out;
+        }
+
+        // tanh'(x) = 1 - tanh(x)^2, so the cached output is all backward needs.
         std::vector<double> backward(std::vector<double> error, double learning_rate) override {
-            std::vector<double> derivative = vectTanhDerivative(input);
-            std::vector<double> grad_input;
-            for(int i = 0; i < derivative.size(); i++){
-                grad_input.push_back(error[i] * derivative[i]);
+            std::vector<double> grad_input(output.size());
+            for(int i = 0; i < output.size(); i++){
+                grad_input[i] = error[i] * (1 - output[i] * output[i]);
             }
             return grad_input;
         }
+
+        size_t saved_bytes(int input_width) const override { return input_width * sizeof(double); }
 };
 
 
@@ -94,25 +200,58 @@ class Linear : public Layer {
         int output_neurons;
         std::vector<std::vector<double>> weights;
         std::vector<double> bias;
+        LinearKernelChoice kernel;
+        bool kernel_selected = false;
 
         Linear(int input_neurons, int output_neurons){
             this->input_neurons = input_neurons;
             this->output_neurons = output_neurons;
             weights = uniformWeightInitializer(output_neurons, input_neurons);
             bias = biasInit(output_neurons);
+            select_kernel();
         }
 
-        std::vector<double> forward(const std::vector<double> intput_data) override {
-            input = intput_data;
-            output.clear();
+        Layer* clone() const override { return new Linear(*this); }
+
+        // Asks the installed kernel selector (if any) once; NN::compile retries
+        // for layers built before the selector was installed.
+        void select_kernel(){
+            if(kernel_selected || !linearKernelSelector()) return;
+            kernel = linearKernelSelector()(input_neurons, output_neurons);
+            kernel_selected = true;
+        }
+
+        void infer(const std::vector<double>& input_data, std::vector<double>& out) const override {
+            if(kernel.forward != ForwardKernel::Reference || kernel.forward_threads > 1){
+                linearForward(kernel, weights, bias, input_data, out);
+                return;
+            }
+            out.resize(output_neurons);
             for(int i = 0; i < output_neurons; i++){
-                output.push_back(dotProduct(weights[i], input) + bias[i]);
+                out[i] = dotProduct(weights[i], input_data) + bias[i];
             }
+        }
 
-            return output;
+        void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) override {
+            if(storage == ActivationStorage::Backward) input = input_data;
+        }
+
+        int input_width() const override { return input_neurons; }
+        int output_width(int input_width) const override { return output_neurons; }
+        size_t saved_bytes(int input_width) const override { return input_neurons * sizeof(double); }
+
+        std::vector<std::vector<double>*> parameters() override {
+            std::vector<std::vector<double>*> params;
+            for(auto& row : weights) params.push_back(&row);
+            params.push_back(&bias);
+            return params;
         }
 
         std::vector<double> backward(std::vector<double> error, double learning_rate) override {
+            if(kernel.backward == BackwardKernel::Fused){
+                return linearBackwardFused(weights, bias, input, error, learning_rate, kernel.backward_threads);
+            }
+
             std::vector<double> input_error;                    //dE/dX
             std::vector<std::vector<double>> weight_error;      //dE/dW
             std::vector<double> bias_error;                     //dE/dB
@@ -151,4 +290,107 @@ class Linear : public Layer {
 
 };
 
+
+class SparseLinear : public Layer {
+    public:
+        int input_neurons;
+        int output_neurons;
+        std::vector<std::vector<double>> weights;   // column-major: weights[j] holds input column j
+        std::vector<double> bias;
+        SparseVector sparse_input;
+        int expected_nnz;       // nonzeros per sample assumed by NN::plan()
+
+        SparseLinear(int input_neurons, int output_neurons, int expected_nnz = 0){
+            this->input_neurons = input_neurons;
+            this->output_neurons = output_neurons;
+            this->expected_nnz = expected_nnz;
+            weights = uniformWeightInitializer(input_neurons, output_neurons);
+            bias = biasInit(output_neurons);
+        }
+
+        using Layer::forward;
+
+        Layer* clone() const override { return new SparseLinear(*this); }
+
+        void check(const SparseVector& input_data) const {
+            if(input_data.size != input_neurons) throw std::invalid_argument("SparseLinear input size mismatch");
+            if(input_data.indices.size() != input_data.values.size()) throw std::invalid_argument("SparseVector has mismatched indices and values");
+            for(int index : input_data.indices){
+                if(index < 0 || index >= input_neurons) throw std::out_of_range("SparseLinear input index out of range");
+            }
+        }
+
+        void infer(const SparseVector& input_data, std::vector<double>& out) const {
+            check(input_data);
+            out = bias;
+            for(int k = 0; k < input_data.nnz(); k++){
+                const std::vector<double>& column = weights[input_data.indices[k]];
+                double value = input_data.values[k];
+                for(int i = 0; i < output_neurons; i++){
+                    out[i] += value * column[i];
+                }
+            }
+        }
+
+        void infer(const std::vector<double>& input_data, std::vector<double>& out) const override {
+            infer(denseToSparse(input_data), out);
+        }
+
+        void forward_into(const SparseVector& input_data, std::vector<double>& out){
+            infer(input_data, out);
+            if(storage != ActivationStorage::None) sparse_input = input_data;
+            if(storage == ActivationStorage::Full) output = out;
+        }
+
+        void forward_into(const std::vector<double>& input_data, std::vector<double>& out) override {
+            forward_into(denseToSparse(input_data), out);
+        }
+
+        std::vector<double> forward(const SparseVector& input_data){
+            std::vector<double> out;
+            forward_into(input_data, out);
+            return out;
+        }
+
+        void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) override {
+            sparse_input = denseToSparse(input_data);
+        }
+
+        int input_width() const override { return input_neurons; }
+        int output_width(int input_width) const override { return output_neurons; }
+        // The real cost depends on each sample's nonzeros; the plan uses expected_nnz.
+        size_t saved_bytes(int input_width) const override {
+            return expected_nnz * (sizeof(int) + sizeof(double));
+        }
+
+        std::vector<std::vector<double>*> parameters() override {
+            std::vector<std::vector<double>*> params;
+            for(auto& column : weights) params.push_back(&column);
+            params.push_back(&bias);
+            return params;
+        }
+
+        void release() override {
+            Layer::release();
+            sparse_input = SparseVector();
+        }
+
+        // The gradient w.r.t. a 1M+ wide sparse input is never consumed (NN::add only
+        // accepts this layer first), so only the active weight columns and the bias
+        // are updated and an empty input error is returned.
+        std::vector<double> backward(std::vector<double> error, double learning_rate) override {
+            for(int k = 0; k < sparse_input.nnz(); k++){
+                std::vector<double>& column = weights[sparse_input.indices[k]];
+                double step = learning_rate * sparse_input.values[k];
+                for(int i = 0; i < output_neurons; i++){
+                    column[i] -= step * error[i];
+                }
+            }
+            for(int i = 0; i < output_neurons; i++){
+                bias[i] -= learning_rate * error[i];
+            }
+            return {};
+        }
+};
+
 #endif
\ No newline at end of file
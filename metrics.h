@@ -0,0 +1,110 @@
+#ifndef METRICS_CPP
+#define METRICS_CPP
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "losses.h"
+
+
+    enum Metric {
+        METRIC_LOSS = 1,
+        METRIC_ACCURACY = 2,
+        METRIC_AUC = 4,
+        METRIC_CALIBRATION = 8,
+        METRIC_ALL = 15
+    };
+
+
+    struct Evaluation {
+        size_t samples = 0;
+        double loss = NAN;          // mean BCE per sample
+        double accuracy = NAN;      // threshold 0.5
+        double auc = NAN;           // ROC AUC from score histograms
+        double ece = NAN;           // expected calibration error
+    };
+
+
+    struct MetricAccumulator {
+    /**
+     * @brief Streaming, mergeable partial aggregates for binary classification metrics
+     *
+     * Every evaluation thread fills its own accumulator and the results are
+     * merged at the end. AUC uses fixed-width histograms of the predicted
+     * probability for positives and negatives instead of sorting all scores;
+     * its error is bounded by the fraction of pairs sharing a bin.
+     */
+        static const int auc_bins = 4096;
+        static const int calibration_bins = 10;
+
+        size_t count = 0;
+        double loss_sum = 0;
+        size_t correct = 0;
+        std::vector<double> positives = std::vector<double>(auc_bins, 0);
+        std::vector<double> negatives = std::vector<double>(auc_bins, 0);
+        std::vector<double> bin_count = std::vector<double>(calibration_bins, 0);
+        std::vector<double> bin_confidence = std::vector<double>(calibration_bins, 0);
+        std::vector<double> bin_positive = std::vector<double>(calibration_bins, 0);
+
+        void add(const std::vector<double>& label, const std::vector<double>& prediction) {
+            double p = std::min(1.0, std::max(0.0, prediction[0]));
+            bool positive = label[0] >= 0.5;
+            count++;
+            loss_sum += BCELoss(label, prediction);
+            if ((p >= 0.5) == positive) correct++;
+
+            int bin = std::min(auc_bins - 1, int(p * auc_bins));
+            (positive ? positives : negatives)[bin] += 1;
+
+            int calibration = std::min(calibration_bins - 1, int(p * calibration_bins));
+            bin_count[calibration] += 1;
+            bin_confidence[calibration] += p;
+            bin_positive[calibration] += positive;
+        }
+
+        void merge(const MetricAccumulator& other) {
+            count += other.count;
+            loss_sum += other.loss_sum;
+            correct += other.correct;
+            for (int b = 0; b < auc_bins; b++) {
+                positives[b] += other.positives[b];
+                negatives[b] += other.negatives[b];
+            }
+            for (int b = 0; b < calibration_bins; b++) {
+                bin_count[b] += other.bin_count[b];
+                bin_confidence[b] += other.bin_confidence[b];
+                bin_positive[b] += other.bin_positive[b];
+            }
+        }
+
+        Evaluation result(int metrics) const {
+            Evaluation evaluation;
+            evaluation.samples = count;
+            if (count == 0) return evaluation;
+            if (metrics & METRIC_LOSS) evaluation.loss = loss_sum / count;
+            if (metrics & METRIC_ACCURACY) evaluation.accuracy = double(correct) / count;
+            if (metrics & METRIC_AUC) {
+                // P(score_pos > score_neg), ties within a bin count one half
+                double total_pos = 0, total_neg = 0, below = 0, area = 0;
+                for (int b = 0; b < auc_bins; b++) {
+                    area += positives[b] * (below + 0.5 * negatives[b]);
+                    below += negatives[b];
+                    total_pos += positives[b];
+                }
+                total_neg = below;
+                if (total_pos > 0 && total_neg > 0) evaluation.auc = area / (total_pos * total_neg);
+            }
+            if (metrics & METRIC_CALIBRATION) {
+                double ece = 0;
+                for (int b = 0; b < calibration_bins; b++) {
+                    if (bin_count[b] == 0) continue;
+                    ece += std::abs(bin_confidence[b] - bin_positive[b]) / count;
+                }
+                evaluation.ece = ece;
+            }
+            return evaluation;
+        }
+    };
+
+
+#endif
\ No newline at end of file
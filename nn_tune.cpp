@@ -0,0 +1,59 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "autotune.h"
+
+// Pre-populates the kernel tuning cache for every Linear shape of a model.
+//
+// Usage: nn_tune <model_file> [cache_path]
+//
+// The model file lists one layer per line, e.g.
+//     Linear 784 256
+//     Relu
+//     Linear 256 10
+// Only Linear lines matter; other lines and lines starting with '#' are skipped.
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <model_file> [cache_path]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream model(argv[1]);
+    if (!model)
+    {
+        std::cerr << "Cannot open model file " << argv[1] << std::endl;
+        return 1;
+    }
+
+    Autotuner& tuner = Autotuner::instance();
+    tuner.verbose = true;
+    tuner.enable(argc > 2 ? argv[2] : defaultTuneCachePath());
+    std::cout << "CPU: " << tuner.cpu << std::endl;
+    std::cout << "Cache: " << tuner.cache_path << std::endl;
+
+    std::string line;
+    while (std::getline(model, line))
+    {
+        std::istringstream fields(line);
+        std::string type;
+        int input_neurons, output_neurons;
+        if (!(fields >> type) || type[0] == '#' || type != "Linear")
+            continue;
+        if (!(fields >> input_neurons >> output_neurons))
+        {
+            std::cerr << "Malformed line: " << line << std::endl;
+            return 1;
+        }
+        if (tuner.cache.count({input_neurons, output_neurons}))
+        {
+            std::cout << "Cached Linear " << input_neurons << "x" << output_neurons << std::endl;
+            continue;
+        }
+        tuner.select(input_neurons, output_neurons);
+    }
+    return 0;
+}
\ No newline at end of file
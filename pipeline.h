@@ -0,0 +1,401 @@
+#ifndef PIPELINE_CPP
+#define PIPELINE_CPP
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <limits>
+#include <iostream>
+#include <stdexcept>
+#include "NN.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+template<typename T>
+class SPSCQueue {
+/**
+ * @brief Bounded lock-free single-producer/single-consumer ring buffer
+ *
+ * One slot is kept empty to tell full from empty. head_ is only written by
+ * the consumer and tail_ only by the producer; each lives on its own cache
+ * line so the two threads do not false-share.
+ */
+    private:
+        std::vector<T> slots_;
+        alignas(64) std::atomic<size_t> head_{0};
+        alignas(64) std::atomic<size_t> tail_{0};
+
+    public:
+        explicit SPSCQueue(size_t capacity) : slots_(capacity + 1) {}
+
+        bool try_push(T& value) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            size_t next = tail + 1 == slots_.size() ? 0 : tail + 1;
+            if (next == head_.load(std::memory_order_acquire)) return false;
+            slots_[tail] = std::move(value);
+            tail_.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& value) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire)) return false;
+            value = std::move(slots_[head]);
+            head_.store(head + 1 == slots_.size() ? 0 : head + 1, std::memory_order_release);
+            return true;
+        }
+
+        void push(T value) {
+            while (!try_push(value)) std::this_thread::yield();
+        }
+
+        T pop() {
+            T value;
+            while (!try_pop(value)) std::this_thread::yield();
+            return value;
+        }
+};
+
+
+    void pinToCore(int core) {
+    /**
+     * @brief Pins the calling thread to one core (no-op outside Linux)
+     * @param core Core index, wrapped around the number of hardware threads
+     */
+#ifdef __linux__
+        int cores = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % cores, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+#endif
+    }
+
+
+    std::vector<double> layerCosts(NN& nn, const std::vector<double>& sample, int repeats = 20) {
+    /**
+     * @brief Measures the forward + backward time of every layer on one sample
+     *
+     * Backward runs with learning rate 0 so the weights are not modified.
+     * Layer storage modes are restored afterwards.
+     *
+     * @param nn The network to profile
+     * @param sample A representative input sample
+     * @param repeats Timed repetitions per layer
+     * @return std::vector<double> Seconds per sample for each layer
+     */
+        std::vector<double> costs(nn.layers.size());
+        std::vector<double> data = sample;
+        std::vector<double> out;
+        for (size_t i = 0; i < nn.layers.size(); i++) {
+            Layer& layer = *nn.layers[i];
+            ActivationStorage previous = layer.storage;
+            layer.storage = ActivationStorage::Backward;
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++) {
+                layer.forward_into(data, out);
+                layer.backward(out, 0);
+            }
+            auto end = std::chrono::steady_clock::now();
+            costs[i] = std::chrono::duration<double>(end - start).count() / repeats;
+            layer.release();
+            layer.storage = previous;
+            data = out;
+        }
+        return costs;
+    }
+
+
+    std::vector<size_t> balanceStages(const std::vector<double>& costs, int stages) {
+    /**
+     * @brief Splits layers into contiguous stages minimizing the slowest stage
+     *
+     * Classic linear partition by dynamic programming, O(layers^2 * stages).
+     *
+     * @param costs Per-layer cost, e.g. from layerCosts
+     * @param stages Number of stages, at most costs.size()
+     * @return std::vector<size_t> First layer index of every stage
+     */
+        int n = costs.size();
+        if (stages <= 0 || stages > n) throw std::invalid_argument("Stage count must be in [1, layers]");
+
+        std::vector<double> prefix(n + 1, 0);
+        for (int i = 0; i < n; i++) prefix[i + 1] = prefix[i] + costs[i];
+
+        // best[s][i]: slowest stage when the first i layers form s stages
+        const double inf = std::numeric_limits<double>::infinity();
+        std::vector<std::vector<double>> best(stages + 1, std::vector<double>(n + 1, inf));
+        std::vector<std::vector<int>> cut(stages + 1, std::vector<int>(n + 1, 0));
+        best[0][0] = 0;
+        for (int s = 1; s <= stages; s++) {
+            for (int i = s; i <= n; i++) {
+                for (int j = s - 1; j < i; j++) {
+                    double cost = std::max(best[s - 1][j], prefix[i] - prefix[j]);
+                    if (cost < best[s][i]) {
+                        best[s][i] = cost;
+                        cut[s][i] = j;
+                    }
+                }
+            }
+        }
+
+        std::vector<size_t> starts(stages);
+        for (int s = stages, i = n; s > 0; s--) {
+            i = cut[s][i];
+            starts[s - 1] = i;
+        }
+        return starts;
+    }
+
+
+enum class PipelineSchedule { GPipe, OneFOneB };
+
+struct PipelineReport {
+    double wall_seconds = 0;
+    double samples_per_second = 0;
+    double bubble_fraction = 0;     // 1 - busy time / (stages * wall time)
+    std::vector<double> stage_busy_seconds;
+};
+
+class PipelineTrainer {
+    public:
+        NN& nn;
+        int stages;
+        PipelineSchedule schedule;
+        int micro_batches;          // micro-batches in flight per flush
+        int micro_batch_size;
+        std::vector<size_t> stage_starts;
+        bool balanced = false;      // false until balance/balance_on ran; fit then measures X[0]
+
+        PipelineTrainer(NN& nn, int stages, PipelineSchedule schedule = PipelineSchedule::OneFOneB,
+                        int micro_batches = 4, int micro_batch_size = 1) : nn(nn) {
+            if(stages <= 0 || stages > nn.layers.size()) throw std::invalid_argument("Stage count must be in [1, layers]");
+            if(micro_batches < 1) throw std::invalid_argument("Need at least one micro-batch per flush");
+            if(micro_batch_size < 1) throw std::invalid_argument("Micro-batch size must be positive");
+            this->stages = stages;
+            this->schedule = schedule;
+            this->micro_batches = micro_batches;
+            this->micro_batch_size = micro_batch_size;
+            stage_starts = balanceStages(std::vector<double>(nn.layers.size(), 1.0), stages);
+        }
+
+        void balance(const std::vector<double>& layer_costs){
+            stage_starts = balanceStages(layer_costs, stages);
+            balanced = true;
+        }
+
+        void balance_on(const std::vector<double>& sample, int repeats = 20){
+            balance(layerCosts(nn, sample, repeats));
+        }
+
+        PipelineReport fit(const std::vector<std::vector<double>>& X, std::vector<std::vector<double>>& Y, int epochs, double learning_rate, bool verbose = true){
+            /**
+             * @brief Trains with one thread per stage, each pinned to its own core
+             *
+             * Micro-batches move forward and gradients move backward through
+             * SPSC queues between neighbouring stages. A stage keeps only the
+             * inputs of its in-flight micro-batches and recomputes its forward
+             * right before the backward, so many micro-batches can be in flight
+             * without per-layer activation copies. The pipeline is flushed every
+             * `micro_batches` micro-batches. Every stage keeps its weights fixed
+             * for the whole flush, so the recomputed forward matches the one
+             * that produced the gradient: the per-sample SGD steps are summed
+             * into a delta and applied once when the flush ends.
+             *
+             * If the stages were never balanced, layer costs are measured on
+             * X[0] first and the layers are split accordingly.
+             *
+             * @return PipelineReport Throughput and bubble fraction of the run
+             */
+            int samples = X.size();
+            if(!balanced && samples > 0) balance_on(X[0]);
+            int total_micro = (samples + micro_batch_size - 1) / micro_batch_size;
+
+            std::vector<ActivationStorage> previous;
+            for(auto& layer : nn.layers){
+                previous.push_back(layer->storage);
+                layer->storage = ActivationStorage::None;
+                layer->release();
+            }
+
+            typedef std::vector<std::vector<double>> Rows;
+            std::vector<std::unique_ptr<SPSCQueue<Rows>>> forward_queues, backward_queues;
+            for(int s = 0; s + 1 < stages; s++){
+                forward_queues.emplace_back(new SPSCQueue<Rows>(micro_batches));
+                backward_queues.emplace_back(new SPSCQueue<Rows>(micro_batches));
+            }
+
+            PipelineReport report;
+            report.stage_busy_seconds.assign(stages, 0);
+
+            auto run_stage = [&](int s){
+                pinToCore(s);
+                kernelThreadLimit() = 1;    // kernel threads would inherit this core's affinity
+                size_t begin = stage_starts[s];
+                size_t end = s + 1 < stages ? stage_starts[s + 1] : nn.layers.size();
+                bool first = s == 0, last = s == stages - 1;
+                std::vector<Rows> stash(micro_batches), loss_grads(micro_batches);
+                std::vector<double> ping, pong;
+                double busy = 0;
+
+                // Per layer of the stage: weights at the start of the flush and the summed updates since
+                std::vector<std::vector<std::vector<double>>> snapshot(end - begin), delta(end - begin);
+
+                auto run_layers = [&](const std::vector<double>& input) -> const std::vector<double>& {
+                    const std::vector<double>* data = &input;
+                    for(size_t i = begin; i < end; i++){
+                        std::vector<double>& buffer = (i - begin) % 2 == 0 ? ping : pong;
+                        nn.layers[i]->forward_into(*data, buffer);
+                        data = &buffer;
+                    }
+                    return *data;
+                };
+
+                for(int epoch = 0; epoch < epochs; epoch++){
+                    double total_loss = 0;
+                    for(int round = 0; round < total_micro; round += micro_batches){
+                        int count = std::min(micro_batches, total_micro - round);
+                        for(size_t i = begin; i < end; i++){
+                            snapshot[i - begin].clear();
+                            delta[i - begin].clear();
+                            for(std::vector<double>* param : nn.layers[i]->parameters()){
+                                snapshot[i - begin].push_back(*param);
+                                delta[i - begin].push_back(std::vector<double>(param->size(), 0));
+                            }
+                        }
+
+                        auto forward = [&](int m){
+                            int offset = (round + m) * micro_batch_size;
+                            Rows rows = first ? Rows(X.begin() + offset, X.begin() + std::min(samples, offset + micro_batch_size))
+                                              : forward_queues[s - 1]->pop();
+                            auto start = std::chrono::steady_clock::now();
+                            Rows outputs(rows.size());
+                            for(size_t j = 0; j < rows.size(); j++){
+                                outputs[j] = run_layers(rows[j]);
+                                if(last){
+                                    total_loss += BCELoss(Y[offset + j], outputs[j]);
+                                    outputs[j] = BCELossDerivative(Y[offset + j], outputs[j]);
+                                }
+                            }
+                            stash[m] = std::move(rows);
+                            busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                            if(last) loss_grads[m] = std::move(outputs);
+                            else forward_queues[s]->push(std::move(outputs));
+                        };
+
+                        auto backward = [&](int m){
+                            Rows grads = last ? std::move(loss_grads[m]) : backward_queues[s]->pop();
+                            auto start = std::chrono::steady_clock::now();
+                            for(size_t j = 0; j < grads.size(); j++){
+                                for(size_t i = begin; i < end; i++) nn.layers[i]->storage = ActivationStorage::Backward;
+                                run_layers(stash[m][j]);
+                                for(size_t i = end; i-- > begin;){
+                                    grads[j] = nn.layers[i]->backward(grads[j], learning_rate);
+                                    nn.layers[i]->storage = ActivationStorage::None;
+                                }
+                                for(size_t i = begin; i < end; i++){
+                                    std::vector<std::vector<double>*> params = nn.layers[i]->parameters();
+                                    for(size_t p = 0; p < params.size(); p++){
+                                        std::vector<double>& param = *params[p];
+                                        const std::vector<double>& base = snapshot[i - begin][p];
+                                        std::vector<double>& sum = delta[i - begin][p];
+                                        for(size_t k = 0; k < param.size(); k++){
+                                            sum[k] += param[k] - base[k];
+                                            param[k] = base[k];
+                                        }
+                                    }
+                                }
+                            }
+                            stash[m].clear();
+                            busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                            if(!first) backward_queues[s - 1]->push(std::move(grads));
+                        };
+
+                        if(schedule == PipelineSchedule::GPipe){
+                            for(int m = 0; m < count; m++) forward(m);
+                            for(int m = 0; m < count; m++) backward(m);
+                        }
+                        else{
+                            int warmup = std::min(stages - 1 - s, count);
+                            for(int m = 0; m < warmup; m++) forward(m);
+                            for(int m = warmup; m < count; m++){
+                                forward(m);
+                                backward(m - warmup);
+                            }
+                            for(int m = count - warmup; m < count; m++) backward(m);
+                        }
+
+                        for(size_t i = begin; i < end; i++){
+                            std::vector<std::vector<double>*> params = nn.layers[i]->parameters();
+                            for(size_t p = 0; p < params.size(); p++)
+                                for(size_t k = 0; k < params[p]->size(); k++) (*params[p])[k] += delta[i - begin][p][k];
+                        }
+                    }
+                    if(last && verbose) std::cout << "Epoch: " << epoch << " Loss: " << total_loss << std::endl;
+                }
+                for(size_t i = begin; i < end; i++) nn.layers[i]->release();
+                report.stage_busy_seconds[s] = busy;
+            };
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for(int s = 0; s < stages; s++) threads.emplace_back(run_stage, s);
+            for(auto& thread : threads) thread.join();
+            report.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for(size_t i = 0; i < nn.layers.size(); i++) nn.layers[i]->storage = previous[i];
+
+            double busy = 0;
+            for(double b : report.stage_busy_seconds) busy += b;
+            report.samples_per_second = double(samples) * epochs / report.wall_seconds;
+            report.bubble_fraction = 1 - busy / (stages * report.wall_seconds);
+            return report;
+        }
+
+        void benchmark(const std::vector<std::vector<double>>& X, std::vector<std::vector<double>>& Y, int epochs = 1){
+            /**
+             * @brief Prints pipeline throughput and bubble fraction against single-threaded training
+             *
+             * Both runs use learning rate 0, so the weights are left untouched.
+             */
+            std::vector<ActivationStorage> previous;
+            for(auto& layer : nn.layers){
+                previous.push_back(layer->storage);
+                layer->storage = ActivationStorage::Backward;
+            }
+            auto start = std::chrono::steady_clock::now();
+            for(int epoch = 0; epoch < epochs; epoch++){
+                for(size_t i = 0; i < X.size(); i++){
+                    std::vector<double> data = X[i];
+                    for(auto& layer : nn.layers) data = layer->forward(data);
+                    data = BCELossDerivative(Y[i], data);
+                    for(auto it = nn.layers.rbegin(); it != nn.layers.rend(); ++it) data = (*it)->backward(data, 0);
+                }
+            }
+            double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for(size_t i = 0; i < nn.layers.size(); i++){
+                nn.layers[i]->release();
+                nn.layers[i]->storage = previous[i];
+            }
+
+            PipelineReport report = fit(X, Y, epochs, 0, false);
+            double single_rate = double(X.size()) * epochs / single;
+            std::cout << "Single-threaded: " << single_rate << " samples/s" << std::endl;
+            std::cout << "Pipeline (" << stages << " stages, " << (schedule == PipelineSchedule::GPipe ? "GPipe" : "1F1B")
+                      << "): " << report.samples_per_second << " samples/s, speedup " << report.samples_per_second / single_rate
+                      << ", bubble " << report.bubble_fraction << std::endl;
+            for(int s = 0; s < stages; s++){
+                std::cout << "  stage " << s << " layers [" << stage_starts[s] << ", "
+                          << (s + 1 < stages ? stage_starts[s + 1] : nn.layers.size()) << ") busy "
+                          << report.stage_busy_seconds[s] << " s" << std::endl;
+            }
+        }
+};
+
+
+#endif
\ No newline at end of file
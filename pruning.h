@@ -0,0 +1,471 @@
+#ifndef PRUNING_CPP
+#define PRUNING_CPP
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include "NN.h"
+
+
+    std::vector<Linear*> linearLayers(NN& nn) {
+    /**
+     * @brief Collects every Linear layer of a network in order
+     * @param nn The network to scan
+     * @return std::vector<Linear*> Non-owning pointers to the Linear layers
+     */
+        std::vector<Linear*> result;
+        for (auto& layer : nn.layers) {
+            Linear* linear = dynamic_cast<Linear*>(layer.get());
+            if (linear != nullptr) result.push_back(linear);
+        }
+        return result;
+    }
+
+
+    double density(const Linear& layer) {
+    /**
+     * @brief Fraction of nonzero weights in a Linear layer
+     * @param layer The layer to inspect
+     * @return double Value in [0, 1]; 1 means fully dense
+     */
+        size_t nonzero = 0;
+        for (const auto& row : layer.weights) {
+            nonzero += std::count_if(row.begin(), row.end(), [](double w) { return w != 0; });
+        }
+        return double(nonzero) / (double(layer.output_neurons) * layer.input_neurons);
+    }
+
+
+    double magnitudeThreshold(std::vector<double> magnitudes, double sparsity) {
+    /**
+     * @brief Finds the magnitude below which a `sparsity` fraction of values fall
+     *
+     * Uses nth_element, so it runs in O(n) on average instead of a full sort.
+     *
+     * @param magnitudes Absolute values of the weights (taken by value, reordered)
+     * @param sparsity Fraction of values to prune, in [0, 1]
+     * @return double Weights with |w| < threshold should be pruned
+     */
+        if (sparsity < 0 || sparsity > 1) throw std::invalid_argument("Sparsity must be in [0, 1]");
+        size_t k = size_t(sparsity * magnitudes.size());
+        if (k == 0) return 0;
+        if (k >= magnitudes.size()) return INFINITY;
+        std::nth_element(magnitudes.begin(), magnitudes.begin() + k, magnitudes.end());
+        return magnitudes[k];
+    }
+
+
+    void magnitudePrune(Linear& layer, double sparsity) {
+    /**
+     * @brief Zeroes the smallest-magnitude weights of a single layer
+     *
+     * @param layer The layer to prune in place
+     * @param sparsity Fraction of the layer's weights to set to zero
+     */
+        std::vector<double> magnitudes;
+        magnitudes.reserve(size_t(layer.output_neurons) * layer.input_neurons);
+        for (const auto& row : layer.weights)
+            for (double w : row) magnitudes.push_back(std::abs(w));
+
+        double threshold = magnitudeThreshold(magnitudes, sparsity);
+        for (auto& row : layer.weights)
+            for (double& w : row)
+                if (std::abs(w) < threshold) w = 0;
+    }
+
+
+    void globalMagnitudePrune(NN& nn, double sparsity) {
+    /**
+     * @brief Zeroes the smallest-magnitude weights across all Linear layers
+     *
+     * A single threshold is shared by every layer, so layers with many small
+     * weights end up sparser than layers with few.
+     *
+     * @param nn The network to prune in place
+     * @param sparsity Fraction of all Linear weights to set to zero
+     */
+        std::vector<Linear*> layers = linearLayers(nn);
+        std::vector<double> magnitudes;
+        for (Linear* layer : layers)
+            for (const auto& row : layer->weights)
+                for (double w : row) magnitudes.push_back(std::abs(w));
+
+        double threshold = magnitudeThreshold(magnitudes, sparsity);
+        for (Linear* layer : layers)
+            for (auto& row : layer->weights)
+                for (double& w : row)
+                    if (std::abs(w) < threshold) w = 0;
+    }
+
+
+    void nmPrune(Linear& layer, int n, int m) {
+    /**
+     * @brief Applies N:M structured pruning to a layer
+     *
+     * In every group of m consecutive weights of a row only the n largest in
+     * magnitude are kept (e.g. 2:4 keeps 50%). A trailing group shorter than m
+     * keeps at most n weights as well.
+     *
+     * @param layer The layer to prune in place
+     * @param n Number of weights kept per group
+     * @param m Group size, at most 255
+     */
+        if (n <= 0 || m <= 0 || n > m || m > 255) throw std::invalid_argument("Invalid N:M pattern");
+        std::vector<int> order(m);
+        for (auto& row : layer.weights) {
+            for (int start = 0; start < row.size(); start += m) {
+                int width = std::min<int>(m, row.size() - start);
+                if (width <= n) continue;
+                for (int t = 0; t < width; t++) order[t] = t;
+                std::partial_sort(order.begin(), order.begin() + n, order.begin() + width,
+                    [&](int a, int b) { return std::abs(row[start + a]) > std::abs(row[start + b]); });
+                for (int t = n; t < width; t++) row[start + order[t]] = 0;
+            }
+        }
+    }
+
+
+    template<int BR, int BC>
+    struct BlockCSRMatrix {
+    /**
+     * @brief Block compressed sparse row storage with BR x BC dense blocks
+     *
+     * The matrix is tiled into BR x BC blocks and only blocks holding at least
+     * one nonzero are stored, row-major inside the block. Block shapes are
+     * compile-time constants so the inner GEMV loops have fixed trip counts
+     * and get vectorized by the compiler. Edge blocks are zero-padded.
+     */
+        int rows = 0;
+        int cols = 0;
+        std::vector<int> block_row_ptr;
+        std::vector<int> block_col;
+        std::vector<double> values;
+
+        BlockCSRMatrix() = default;
+
+        explicit BlockCSRMatrix(const std::vector<std::vector<double>>& dense) {
+            rows = dense.size();
+            cols = rows == 0 ? 0 : dense[0].size();
+            int block_rows = (rows + BR - 1) / BR;
+            int block_cols = (cols + BC - 1) / BC;
+            block_row_ptr.push_back(0);
+            for (int br = 0; br < block_rows; br++) {
+                for (int bc = 0; bc < block_cols; bc++) {
+                    double block[BR * BC] = {};
+                    bool any = false;
+                    for (int r = 0; r < BR; r++) {
+                        for (int c = 0; c < BC; c++) {
+                            int i = br * BR + r, j = bc * BC + c;
+                            if (i < rows && j < cols && dense[i][j] != 0) {
+                                block[r * BC + c] = dense[i][j];
+                                any = true;
+                            }
+                        }
+                    }
+                    if (!any) continue;
+                    block_col.push_back(bc);
+                    values.insert(values.end(), block, block + BR * BC);
+                }
+                block_row_ptr.push_back(block_col.size());
+            }
+        }
+
+        double stored_density() const { return rows * cols == 0 ? 0 : double(values.size()) / (double(rows) * cols); }
+
+        size_t memory_bytes() const {
+            return values.size() * sizeof(double) + (block_col.size() + block_row_ptr.size()) * sizeof(int);
+        }
+    };
+
+
+    template<int BR, int BC>
+    void bcsrGemv(const BlockCSRMatrix<BR, BC>& w, const std::vector<double>& x, std::vector<double>& y) {
+    /**
+     * @brief Accumulates y += W * x for a block-CSR matrix
+     *
+     * @param w The block-CSR weights (rows x cols)
+     * @param x Dense input of size cols
+     * @param y Dense output of size rows, accumulated into
+     */
+        int padded_cols = (w.cols + BC - 1) / BC * BC;
+        const double* xp = x.data();
+        std::vector<double> x_pad;
+        if (padded_cols != w.cols) {
+            x_pad.assign(padded_cols, 0);
+            std::copy(x.begin(), x.end(), x_pad.begin());
+            xp = x_pad.data();
+        }
+
+        int block_rows = w.block_row_ptr.size() - 1;
+        for (int br = 0; br < block_rows; br++) {
+            double acc[BR] = {};
+            for (int k = w.block_row_ptr[br]; k < w.block_row_ptr[br + 1]; k++) {
+                const double* block = &w.values[size_t(k) * BR * BC];
+                const double* xb = xp + w.block_col[k] * BC;
+                for (int r = 0; r < BR; r++)
+                    for (int c = 0; c < BC; c++)
+                        acc[r] += block[r * BC + c] * xb[c];
+            }
+            for (int r = 0; r < BR && br * BR + r < w.rows; r++) y[br * BR + r] += acc[r];
+        }
+    }
+
+
+    struct NMPackedMatrix {
+    /**
+     * @brief N:M packed storage: n values plus n in-group offsets per group of m columns
+     *
+     * Every row is split into ceil(cols / m) groups and each group stores
+     * exactly n (value, offset) slots, so the layout is fully regular and
+     * needs no row pointers. Groups with fewer than n nonzeros are padded
+     * with zero values. Built from weights that already follow the pattern
+     * (see nmPrune); otherwise the n largest of each group are kept.
+     */
+        int rows = 0;
+        int cols = 0;
+        int n = 0;
+        int m = 0;
+        std::vector<double> values;
+        std::vector<uint8_t> offsets;
+
+        NMPackedMatrix() = default;
+
+        NMPackedMatrix(const std::vector<std::vector<double>>& dense, int n, int m) : n(n), m(m) {
+            if (n <= 0 || m <= 0 || n > m || m > 255) throw std::invalid_argument("Invalid N:M pattern");
+            rows = dense.size();
+            cols = rows == 0 ? 0 : dense[0].size();
+            int groups = (cols + m - 1) / m;
+            values.reserve(size_t(rows) * groups * n);
+            offsets.reserve(size_t(rows) * groups * n);
+            std::vector<int> order(m);
+            for (const auto& row : dense) {
+                for (int g = 0; g < groups; g++) {
+                    int start = g * m;
+                    int width = std::min(m, cols - start);
+                    for (int t = 0; t < width; t++) order[t] = t;
+                    int keep = std::min(n, width);
+                    std::partial_sort(order.begin(), order.begin() + keep, order.begin() + width,
+                        [&](int a, int b) { return std::abs(row[start + a]) > std::abs(row[start + b]); });
+                    std::sort(order.begin(), order.begin() + keep);
+                    for (int t = 0; t < n; t++) {
+                        bool used = t < keep;
+                        values.push_back(used ? row[start + order[t]] : 0);
+                        offsets.push_back(used ? order[t] : 0);
+                    }
+                }
+            }
+        }
+
+        double stored_density() const { return rows * cols == 0 ? 0 : double(values.size()) / (double(rows) * cols); }
+
+        size_t memory_bytes() const { return values.size() * sizeof(double) + offsets.size() * sizeof(uint8_t); }
+    };
+
+
+    void nmGemv(const NMPackedMatrix& w, const std::vector<double>& x, std::vector<double>& y) {
+    /**
+     * @brief Accumulates y += W * x for an N:M packed matrix
+     *
+     * @param w The packed weights (rows x cols)
+     * @param x Dense input of size cols
+     * @param y Dense output of size rows, accumulated into
+     */
+        int groups = (w.cols + w.m - 1) / w.m;
+        size_t slots = size_t(groups) * w.n;
+        for (int i = 0; i < w.rows; i++) {
+            const double* v = &w.values[i * slots];
+            const uint8_t* off = &w.offsets[i * slots];
+            double acc = 0;
+            for (int g = 0; g < groups; g++) {
+                const double* xg = &x[g * w.m];
+                for (int t = 0; t < w.n; t++) acc += v[g * w.n + t] * xg[off[g * w.n + t]];
+            }
+            y[i] += acc;
+        }
+    }
+
+
+    enum class SparseFormat { BlockCSR, NMPacked };
+
+    // Auto times both kernels on the layer itself and keeps the faster one.
+    enum class KernelPolicy { Auto, Dense, Sparse };
+
+
+class SparseInferenceLinear : public Layer {
+    public:
+        typedef BlockCSRMatrix<1, 4> BlockWeights;
+
+        int input_neurons;
+        int output_neurons;
+        SparseFormat format;
+        bool use_dense;
+        std::vector<std::vector<double>> dense_weights;
+        BlockWeights block_weights;
+        NMPackedMatrix nm_weights;
+        std::vector<double> bias;
+
+        // Where sparse starts to win depends on the format, the sparsity pattern
+        // and the CPU, so KernelPolicy::Auto measures the crossover per layer:
+        // both kernels are timed on a probe input and the slower representation
+        // is dropped.
+        SparseInferenceLinear(const Linear& layer, SparseFormat format = SparseFormat::BlockCSR,
+                              KernelPolicy policy = KernelPolicy::Auto, int n = 2, int m = 4){
+            input_neurons = layer.input_neurons;
+            output_neurons = layer.output_neurons;
+            this->format = format;
+            bias = layer.bias;
+            if(format == SparseFormat::BlockCSR) block_weights = BlockWeights(layer.weights);
+            else nm_weights = NMPackedMatrix(layer.weights, n, m);
+            dense_weights = layer.weights;
+
+            if(policy == KernelPolicy::Auto){
+                std::vector<double> probe = biasInit(input_neurons);
+                double dense_seconds = probe_seconds(true, probe);
+                double sparse_seconds = probe_seconds(false, probe);
+                use_dense = dense_seconds <= sparse_seconds;
+            }
+            else{
+                use_dense = policy == KernelPolicy::Dense;
+            }
+
+            if(use_dense){
+                block_weights = BlockWeights();
+                nm_weights = NMPackedMatrix();
+            }
+            else{
+                dense_weights.clear();
+                dense_weights.shrink_to_fit();
+            }
+        }
+
+        Layer* clone() const override { return new SparseInferenceLinear(*this); }
+
+        void infer(const std::vector<double>& input_data, std::vector<double>& out) const override {
+            out = bias;
+            if(use_dense){
+                for(int i = 0; i < output_neurons; i++){
+                    out[i] += dotProduct(dense_weights[i], input_data);
+                }
+            }
+            else if(format == SparseFormat::BlockCSR){
+                bcsrGemv(block_weights, input_data, out);
+            }
+            else{
+                nmGemv(nm_weights, input_data, out);
+            }
+        }
+
+        void save_for_backward(const std::vector<double>& input_data, const std::vector<double>& out) override {}
+
+        std::vector<double> backward(std::vector<double> error, double learning_rate) override {
+            throw std::logic_error("SparseInferenceLinear is inference-only");
+        }
+
+        int input_width() const override { return input_neurons; }
+        int output_width(int input_width) const override { return output_neurons; }
+        size_t saved_bytes(int input_width) const override { return 0; }
+
+        size_t memory_bytes() const {
+            size_t bytes = bias.size() * sizeof(double);
+            if(use_dense) return bytes + size_t(output_neurons) * input_neurons * sizeof(double);
+            if(format == SparseFormat::BlockCSR) return bytes + block_weights.memory_bytes();
+            return bytes + nm_weights.memory_bytes();
+        }
+
+    private:
+        // Best of a few short runs, so one preempted run does not flip the choice.
+        double probe_seconds(bool dense, const std::vector<double>& probe){
+            use_dense = dense;
+            std::vector<double> out;
+            infer(probe, out);
+            double best = INFINITY;
+            for(int trial = 0; trial < 5; trial++){
+                auto start = std::chrono::steady_clock::now();
+                for(int r = 0; r < 4; r++) infer(probe, out);
+                best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            return best;
+        }
+
+};
+
+
+    void sparsifyForInference(NN& nn, SparseFormat format = SparseFormat::BlockCSR, KernelPolicy policy = KernelPolicy::Auto, int n = 2, int m = 4) {
+    /**
+     * @brief Replaces every Linear layer of a trained network by a SparseInferenceLinear
+     *
+     * Prune first (magnitudePrune, globalMagnitudePrune or nmPrune); with
+     * KernelPolicy::Auto each layer keeps whichever kernel measured faster.
+     *
+     * @param nn The network to convert in place; it can no longer be trained
+     */
+        for (auto& layer : nn.layers) {
+            Linear* linear = dynamic_cast<Linear*>(layer.get());
+            if (linear != nullptr) layer.reset(new SparseInferenceLinear(*linear, format, policy, n, m));
+        }
+    }
+
+
+    void sparsityReport(int input_neurons, int output_neurons, std::vector<double> sparsities, int iterations = 200) {
+    /**
+     * @brief Prints memory footprint and latency of sparse vs dense inference
+     *
+     * For every sparsity level a random layer is magnitude-pruned and timed in
+     * block-CSR format; 2:4 and 1:4 N:M patterns are timed as well. Both
+     * paths are forced so both columns are real measurements; the last column
+     * shows which path KernelPolicy::Auto picks.
+     *
+     * @param input_neurons Layer input width
+     * @param output_neurons Layer output width
+     * @param sparsities Unstructured sparsity levels to measure, in [0, 1)
+     * @param iterations Forward passes timed per configuration
+     */
+        std::vector<double> x(input_neurons);
+        for (int j = 0; j < input_neurons; j++) x[j] = std::sin(0.1 * j);
+
+        auto time_us = [&](Layer& layer) {
+            layer.storage = ActivationStorage::None;
+            layer.forward(x);
+            auto start = std::chrono::steady_clock::now();
+            for (int it = 0; it < iterations; it++) layer.forward(x);
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+        };
+
+        auto report = [&](const std::string& name, const Linear& pruned, SparseFormat format, int n, int m) {
+            SparseInferenceLinear dense(pruned, format, KernelPolicy::Dense, n, m);
+            SparseInferenceLinear sparse(pruned, format, KernelPolicy::Sparse, n, m);
+            SparseInferenceLinear automatic(pruned, format, KernelPolicy::Auto, n, m);
+            std::cout << std::left << std::setw(12) << name
+                      << std::setw(12) << density(pruned)
+                      << std::setw(14) << dense.memory_bytes()
+                      << std::setw(14) << sparse.memory_bytes()
+                      << std::setw(12) << time_us(dense)
+                      << std::setw(12) << time_us(sparse)
+                      << (automatic.use_dense ? "dense" : "sparse") << std::endl;
+        };
+
+        std::cout << "Layer " << input_neurons << "x" << output_neurons << std::endl;
+        std::cout << std::left << std::setw(12) << "pattern" << std::setw(12) << "density"
+                  << std::setw(14) << "dense_bytes" << std::setw(14) << "sparse_bytes"
+                  << std::setw(12) << "dense_us" << std::setw(12) << "sparse_us" << "auto" << std::endl;
+
+        for (double sparsity : sparsities) {
+            Linear layer(input_neurons, output_neurons);
+            magnitudePrune(layer, sparsity);
+            report("bcsr " + std::to_string(int(sparsity * 100)) + "%", layer, SparseFormat::BlockCSR, 2, 4);
+        }
+        for (int n : {2, 1}) {
+            Linear layer(input_neurons, output_neurons);
+            nmPrune(layer, n, 4);
+            report(std::to_string(n) + ":4", layer, SparseFormat::NMPacked, n, 4);
+        }
+    }
+
+
+#endif
\ No newline at end of file
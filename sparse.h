@@ -0,0 +1,159 @@
+#ifndef SPARSE_CPP
+#define SPARSE_CPP
+
+#include <vector>
+#include <stdexcept>
+
+
+    struct SparseVector {
+    /**
+     * @brief A single sparse sample stored as (index, value) pairs
+     *
+     * Only the nonzero entries are kept. `size` is the logical (dense) length,
+     * `indices` holds the column of each nonzero and `values` its value.
+     */
+        int size = 0;
+        std::vector<int> indices;
+        std::vector<double> values;
+
+        size_t nnz() const { return indices.size(); }
+    };
+
+
+    struct COOMatrix {
+    /**
+     * @brief A batch of sparse samples in coordinate (COO) format
+     *
+     * Every nonzero is stored as a (row, col, value) triplet. Entries do not
+     * have to be sorted; use cooToCSR to convert the batch before training.
+     */
+        int rows = 0;
+        int cols = 0;
+        std::vector<int> row_idx;
+        std::vector<int> col_idx;
+        std::vector<double> values;
+    };
+
+
+    struct CSRMatrix {
+    /**
+     * @brief A batch of sparse samples in compressed sparse row (CSR) format
+     *
+     * The nonzeros of row r live in [row_ptr[r], row_ptr[r + 1]) of `col_idx`
+     * and `values`. `row_ptr` therefore always has rows + 1 entries.
+     */
+        int rows = 0;
+        int cols = 0;
+        std::vector<int> row_ptr = {0};
+        std::vector<int> col_idx;
+        std::vector<double> values;
+
+        size_t nnz() const { return col_idx.size(); }
+
+        void check() const {
+        /**
+         * @brief Validates the CSR structure before rows are read from it
+         * @throws std::invalid_argument if row_ptr or values do not describe rows x cols
+         * @throws std::out_of_range if a column index lies outside [0, cols)
+         */
+            if (row_ptr.size() != rows + 1 || row_ptr[0] != 0 || row_ptr.back() != nnz() || values.size() != nnz())
+                throw std::invalid_argument("Malformed CSR batch");
+            for (int r = 0; r < rows; r++) {
+                if (row_ptr[r] > row_ptr[r + 1]) throw std::invalid_argument("Malformed CSR batch");
+            }
+            for (int index : col_idx) {
+                if (index < 0 || index >= cols) throw std::out_of_range("Sparse index outside row width");
+            }
+        }
+
+        SparseVector row(int r) const {
+        /**
+         * @brief Copies row r out of the batch as a SparseVector
+         * @param r The row index, must be in [0, rows)
+         * @return SparseVector The nonzeros of the requested row
+         */
+            SparseVector v;
+            v.size = cols;
+            v.indices.assign(col_idx.begin() + row_ptr[r], col_idx.begin() + row_ptr[r + 1]);
+            v.values.assign(values.begin() + row_ptr[r], values.begin() + row_ptr[r + 1]);
+            return v;
+        }
+
+        void add_row(const SparseVector& v) {
+        /**
+         * @brief Appends a sparse sample as a new row of the batch
+         * @param v The sample to append
+         * @throws std::invalid_argument if v.size does not match the batch width
+         * @throws std::out_of_range if an index lies outside [0, v.size)
+         */
+            if (rows == 0 && cols == 0) cols = v.size;
+            if (v.size != cols) throw std::invalid_argument("Row size does not match CSR width");
+            if (v.indices.size() != v.values.size()) throw std::invalid_argument("Sparse row has mismatched indices and values");
+            for (int index : v.indices) {
+                if (index < 0 || index >= cols) throw std::out_of_range("Sparse index outside row width");
+            }
+            col_idx.insert(col_idx.end(), v.indices.begin(), v.indices.end());
+            values.insert(values.end(), v.values.begin(), v.values.end());
+            row_ptr.push_back(col_idx.size());
+            rows++;
+        }
+    };
+
+
+    SparseVector denseToSparse(const std::vector<double>& v) {
+    /**
+     * @brief Extracts the nonzero entries of a dense vector
+     *
+     * @param v The dense vector
+     * @return SparseVector The nonzeros of v in increasing index order
+     */
+        SparseVector s;
+        s.size = v.size();
+        for (int i = 0; i < v.size(); i++) {
+            if (v[i] != 0) {
+                s.indices.push_back(i);
+                s.values.push_back(v[i]);
+            }
+        }
+        return s;
+    }
+
+
+    CSRMatrix cooToCSR(const COOMatrix& coo) {
+    /**
+     * @brief Converts a COO batch into CSR format
+     *
+     * Uses a counting sort over the row indices, so the conversion is
+     * O(nnz + rows). Within a row, entries keep their original COO order.
+     *
+     * @param coo The COO batch to convert
+     * @return CSRMatrix The same batch in CSR format
+     * @throws std::out_of_range if a row or column index is outside the batch shape
+     */
+        CSRMatrix csr;
+        csr.rows = coo.rows;
+        csr.cols = coo.cols;
+        csr.row_ptr.assign(coo.rows + 1, 0);
+        csr.col_idx.resize(coo.values.size());
+        csr.values.resize(coo.values.size());
+
+        for (int k = 0; k < coo.values.size(); k++) {
+            if (coo.row_idx[k] < 0 || coo.row_idx[k] >= coo.rows || coo.col_idx[k] < 0 || coo.col_idx[k] >= coo.cols)
+                throw std::out_of_range("COO entry outside matrix shape");
+            csr.row_ptr[coo.row_idx[k] + 1]++;
+        }
+        for (int r = 0; r < coo.rows; r++) {
+            csr.row_ptr[r + 1] += csr.row_ptr[r];
+        }
+
+        std::vector<int> next(csr.row_ptr.begin(), csr.row_ptr.end() - 1);
+        for (int k = 0; k < coo.values.size(); k++) {
+            int dst = next[coo.row_idx[k]]++;
+            csr.col_idx[dst] = coo.col_idx[k];
+            csr.values[dst] = coo.values[k];
+        }
+        return csr;
+    }
+
+
+#endif
\ No newline at end of file
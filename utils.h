@@ -9,7 +9,7 @@
 
 
     
-    double dotProduct(std::vector<double>& v1, std::vector<double>& v2) {
+    double dotProduct(const std::vector<double>& v1, const std::vector<double>& v2) {
     /**
      * @brief Calculates the dot product of two vectors
      * 